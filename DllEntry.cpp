@@ -1,5 +1,6 @@
 #include "HoudiniEngine.h"
 #include "HoudiniEngine_mesh.h"
+#include "HoudiniEngine_object.h"
 #include <TlHelp32.h>
 
 
@@ -56,6 +57,7 @@ __declspec( dllexport ) ClassDesc* LibClassDesc(int i)
 {
 	switch(i) {
 		case 0: return GetHoudiniEngineMeshDesc();
+		case 1: return GetHoudiniEngineObjectDesc();
 		default: return nullptr;
 	}
 }
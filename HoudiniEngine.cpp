@@ -373,6 +373,8 @@ int Part::numAttribs(HAPI_AttributeOwner attrib_owner) const
 std::vector<std::string> Part::attribNames(HAPI_AttributeOwner attrib_owner) const
 {
     int num_attribs = numAttribs(attrib_owner);
+    if (!num_attribs)
+        return std::vector<std::string>();
     std::vector<int> attrib_names_sh(num_attribs);
 
 	throwOnFailure(HAPI_GetAttributeNames(hapi::Engine::instance()->session(),
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include "HoudiniEngine_cache.h"
+
+void PartBlock::clear()
+{
+	pointsInMesh = false;
+	released = false;
+	points.clear();
+	faces.clear();
+	smGroups.clear();
+	matIds.clear();
+	edgeVis.clear();
+	maps.clear();
+	normals.clear();
+	normalFaces.clear();
+	groups.clear();
+	polyNormals.clear();
+	polyDegrees.clear();
+	polyVerts.clear();
+}
+
+void PartBlock::release()
+{
+	std::vector<PartGroup> keepGroups;
+	std::vector<int> keepDegrees;
+	keepGroups.swap(groups);
+	keepDegrees.swap(polyDegrees);
+	clear();
+	groups.swap(keepGroups);
+	polyDegrees.swap(keepDegrees);
+	released = true;
+
+	// clear keeps the capacity
+	std::vector<float>().swap(points);
+	std::vector<int>().swap(faces);
+	std::vector<unsigned int>().swap(smGroups);
+	std::vector<unsigned short>().swap(matIds);
+	std::vector<unsigned char>().swap(edgeVis);
+	std::vector<PartMap>().swap(maps);
+	std::vector<float>().swap(normals);
+	std::vector<int>().swap(normalFaces);
+	std::vector<int>().swap(polyNormals);
+	std::vector<int>().swap(polyVerts);
+}
+
+PartBlock* GeometryCache::find(const PartKey& key)
+{
+	std::map<PartKey, PartBlock>::iterator it = blocks.find(key);
+	return it != blocks.end() ? &it->second : NULL;
+}
+
+PartBlock& GeometryCache::get(const PartKey& key)
+{
+	return blocks[key];
+}
+
+void GeometryCache::getBlocks(std::vector<const PartBlock*>& out) const
+{
+	out.clear();
+	for ( std::map<PartKey, PartBlock>::const_iterator it = blocks.begin(); it != blocks.end(); ++it )
+		out.push_back(&it->second);
+}
+
+void GeometryCache::retain(const std::vector<PartKey>& keys)
+{
+	if ( keys.size() == blocks.size() )
+	{
+		bool same = true;
+		for ( size_t i = 0; i < keys.size() && same; ++i )
+		{
+			same = blocks.find(keys[i]) != blocks.end();
+		}
+		if ( same )
+			return;
+	}
+
+	std::vector<PartKey> sorted(keys);
+	std::sort(sorted.begin(), sorted.end());
+
+	std::map<PartKey, PartBlock>::iterator it = blocks.begin();
+	while ( it != blocks.end() )
+	{
+		if ( !std::binary_search(sorted.begin(), sorted.end(), it->first) )
+			blocks.erase(it++);
+		else
+			++it;
+	}
+}
+
+void ParticleCloud::resize(int count)
+{
+	positions.resize(count * 3);
+	velocities.resize(count * 3);
+	scales.resize(count);
+	ages.resize(count);
+	ids.resize(count);
+}
+
+void ParticleCloud::clear()
+{
+	resize(0);
+	for ( int k = 0; k < 3; ++k )
+	{
+		boundsMin[k] = 0.f;
+		boundsMax[k] = 0.f;
+	}
+}
+
+void ParticleCloud::updateBounds()
+{
+	for ( int k = 0; k < 3; ++k )
+	{
+		boundsMin[k] = count() ? positions[k] : 0.f;
+		boundsMax[k] = boundsMin[k];
+	}
+	for ( int i = 1; i < count(); ++i )
+	{
+		for ( int k = 0; k < 3; ++k )
+		{
+			boundsMin[k] = std::min(boundsMin[k], positions[i*3+k]);
+			boundsMax[k] = std::max(boundsMax[k], positions[i*3+k]);
+		}
+	}
+}
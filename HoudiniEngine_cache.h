@@ -0,0 +1,163 @@
+#ifndef __HOUDINIENGINE_CACHE__
+#define __HOUDINIENGINE_CACHE__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <map>
+
+// identifies a cooked part inside an asset
+struct PartKey
+{
+	PartKey() : object(-1), geo(-1), part(-1) {}
+	PartKey(int object, int geo, int part) : object(object), geo(geo), part(part) {}
+
+	bool operator<(const PartKey& other) const
+	{
+		if ( object != other.object )
+			return object < other.object;
+		if ( geo != other.geo )
+			return geo < other.geo;
+		return part < other.part;
+	}
+	bool operator==(const PartKey& other) const
+	{
+		return object == other.object && geo == other.geo && part == other.part;
+	}
+
+	int		object;
+	int		geo;
+	int		part;
+};
+
+// part info values that have to match before a cached part can be reused
+struct PartFingerprint
+{
+	PartFingerprint() : faceCount(0), vertexCount(0), pointCount(0),
+		pointAttributeCount(0), faceAttributeCount(0), vertexAttributeCount(0), detailAttributeCount(0) {}
+
+	bool operator==(const PartFingerprint& other) const
+	{
+		return faceCount == other.faceCount
+			&& vertexCount == other.vertexCount
+			&& pointCount == other.pointCount
+			&& pointAttributeCount == other.pointAttributeCount
+			&& faceAttributeCount == other.faceAttributeCount
+			&& vertexAttributeCount == other.vertexAttributeCount
+			&& detailAttributeCount == other.detailAttributeCount;
+	}
+	bool operator!=(const PartFingerprint& other) const { return !(*this == other); }
+
+	int		faceCount;
+	int		vertexCount;
+	int		pointCount;
+	int		pointAttributeCount;
+	int		faceAttributeCount;
+	int		vertexAttributeCount;
+	int		detailAttributeCount;
+};
+
+// one map channel of a part
+struct PartMap
+{
+	PartMap() : channel(1) {}
+
+	int							channel;
+	std::vector<float>			tverts;		// uvw (or rgb) per tvert
+	std::vector<int>			tvFaces;	// 3 part local tvert indices per triangle
+	std::vector<int>			polyTVerts;	// polygon mode, part local tvert per corner
+
+	int numTVerts() const { return (int)(tverts.size() / 3); }
+};
+
+// primitive group of a part as a bitset over the faces of its block,
+// triangles or polygons depending on the output mode
+struct PartGroup
+{
+	std::string					name;
+	std::vector<uint32_t>		bits;		// bit n of word n / 32 = face n
+
+	bool contains(int face) const { return (bits[face >> 5] >> (face & 31)) & 1; }
+};
+
+// converted geometry of a part, ready to be copied into the output mesh
+struct PartBlock
+{
+	PartBlock() : topologyHash(0), pointsHash(0), contentHash(0), vertOfs(0), faceOfs(0), normalOfs(0), pointsInMesh(false), released(false) {}
+
+	PartFingerprint				fingerprint;
+	uint64_t					topologyHash;	// face counts and vertex list
+	uint64_t					pointsHash;		// raw P and N as fetched, and the scale
+	uint64_t					contentHash;	// raw topology and attributes except P and N, and the output mode
+	int							vertOfs;	// first vertex in the assembled mesh
+	int							faceOfs;	// first face (or polygon) in the assembled mesh
+	int							normalOfs;	// first specified normal in the assembled mesh
+	bool						pointsInMesh;	// deformed in place, points stays allocated but is stale until read back from the mesh
+	bool						released;		// only in the mesh, see release()
+	std::vector<float>			points;		// xyz per point, max coordinate system
+	std::vector<int>			faces;		// 3 part local point indices per triangle
+	std::vector<unsigned int>	smGroups;	// per triangle, per polygon in polygon mode
+	std::vector<unsigned short>	matIds;		// per triangle, per polygon in polygon mode
+	std::vector<unsigned char>	edgeVis;	// per triangle, bit n = edge n visible
+	std::vector<PartMap>		maps;		// sorted by channel, a part without uvs gets an empty channel 1
+	std::vector<float>			normals;	// xyz per cooked N, max coordinate system, empty without N
+	std::vector<int>			normalFaces;	// 3 part local normal indices per triangle
+	std::vector<PartGroup>		groups;		// sorted by name
+
+	// polygon mode, faces/edgeVis stay empty
+	std::vector<int>			polyDegrees;	// corners per polygon
+	std::vector<int>			polyVerts;		// part local point per corner, max winding
+	std::vector<int>			polyNormals;	// part local normal per corner, empty without N
+
+	int numPoints() const { return (int)(points.size() / 3); }
+	int numFaces() const { return (int)(faces.size() / 3); }
+	int numNormals() const { return (int)(normals.size() / 3); }
+	int numPolys() const { return (int)polyDegrees.size(); }
+	void clear();
+	// frees the geometry once it was copied into the mesh, the offsets, hashes, groups and polygon
+	// degrees stay, GetFaceGroups needs them.
+	// the part has to be fetched and converted again before the mesh can be assembled again
+	void release();
+};
+
+// converted parts of one asset, persists between cooks
+class GeometryCache
+{
+public:
+	void clear() { blocks.clear(); }
+	size_t size() const { return blocks.size(); }
+
+	PartBlock* find(const PartKey& key);
+	PartBlock& get(const PartKey& key);
+
+	// every cached block, in key order
+	void getBlocks(std::vector<const PartBlock*>& out) const;
+
+	// drop every part that is not listed in keys
+	void retain(const std::vector<PartKey>& keys);
+
+private:
+	std::map<PartKey, PartBlock>	blocks;
+};
+
+// point-only parts of an asset as particles, max coordinate system.
+// the arrays keep their capacity so per frame updates do not reallocate
+struct ParticleCloud
+{
+	std::vector<float>	positions;	// xyz per particle
+	std::vector<float>	velocities;	// xyz per particle, units per tick like max particles
+	std::vector<float>	scales;		// pscale
+	std::vector<float>	ages;		// seconds
+	std::vector<int>	ids;		// id, particle index without it
+	float				boundsMin[3];
+	float				boundsMax[3];
+
+	ParticleCloud() { clear(); }
+	int count() const { return (int)ids.size(); }
+	void resize(int count);
+	void clear();
+	void updateBounds();
+};
+
+#endif // __HOUDINIENGINE_CACHE__
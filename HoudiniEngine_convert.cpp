@@ -0,0 +1,803 @@
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <utility>
+#include "HoudiniEngine_convert.h"
+#include "HoudiniEngine_hash.h"
+#include "HoudiniEngine_parallel.h"
+#include "HoudiniEngine_xform.h"
+
+namespace util
+{
+	void ConvertPoints( float* points, int count, float scl )
+	{
+		Affine34 m;
+		HoudiniToMaxTransform( scl, m );
+		TransformPoints( points, points, count, m );
+	}
+
+	void ConvertNormals( float* normals, int count )
+	{
+		Affine34 m;
+		HoudiniToMaxTransform( 1.f, m );
+		TransformPoints( normals, normals, count, m );
+	}
+
+	// uvw of the i-th value, a single float (Alpha) goes to all three
+	static inline void GetUVW( const PartUV& src, size_t i, float* uvw )
+	{
+		const float* p = &src.uv[i * src.tupleSize];
+		if ( src.tupleSize == 1 )
+		{
+			uvw[0] = uvw[1] = uvw[2] = p[0];
+			return;
+		}
+		uvw[0] = p[0];
+		uvw[1] = p[1];
+		uvw[2] = src.tupleSize > 2 ? p[2] : 0.f;
+	}
+
+	// attempt to restore the shared UVs. cornerTVerts holds the value index per vertex and
+	// gets the uv index per vertex, vertices with the same uvNumber and the same uvw share one tvert
+	static void RestoreSharedUVs( const PartUV& src, std::vector<int>& cornerTVerts, std::vector<float>& tverts )
+	{
+		size_t numVertices = cornerTVerts.size();
+		tverts.resize(numVertices * 3);
+
+		UVTable table(numVertices);
+
+		int uvCount = 0;
+		for (size_t i = 0; i < numVertices; ++i)
+		{
+			int value = cornerTVerts[i];
+			float uvw[3];
+			GetUVW(src, value, uvw);
+
+			int mappedUVIndex = table.insert(src.uvNumbers.size() ? src.uvNumbers[value] : 0, uvw, uvCount);
+			if (mappedUVIndex == uvCount)
+			{
+				memcpy(&tverts[uvCount * 3], uvw, sizeof(uvw));
+				uvCount++;
+			}
+			cornerTVerts[i] = mappedUVIndex;
+		}
+		tverts.resize(uvCount * 3);
+	}
+
+	// fill map.tverts and the tvert of every houdini vertex
+	static void BuildTVerts( const PartSource& part, const PartUV& src, PartMap& map, std::vector<int>& cornerTVerts )
+	{
+		const std::vector<int>& polyCount = part.polyCount;
+		const std::vector<int>& polyConnect = part.polyConnect;
+		size_t numVertices = polyConnect.size();
+
+		int uvSize = src.owner != owner_none ? (int)(src.uv.size() / src.tupleSize) : 0;
+		if (uvSize <= 1)
+		{
+			// add dummy UV and set to empty uvs
+			map.tverts.assign(3, 0.f);
+			if (uvSize)
+				GetUVW(src, 0, &map.tverts.front());
+			cornerTVerts.assign(numVertices, 0);
+			return;
+		}
+
+		// value index of every houdini vertex
+		cornerTVerts.resize(numVertices);
+		if (src.owner == owner_point)
+			cornerTVerts = polyConnect;
+		else if (src.owner == owner_vertex)
+		{
+			for (size_t i = 0; i < numVertices; ++i)
+				cornerTVerts[i] = (int)i;
+		}
+		else
+		{
+			size_t currentVtxIndex = 0;
+			for (size_t f = 0; f < polyCount.size(); ++f)
+			{
+				for (int j = 0; j < polyCount[f]; ++j)
+					cornerTVerts[currentVtxIndex++] = (int)f;
+			}
+		}
+
+		// uvs with uvNumber and colors on vertices or primitives are shared by value
+		if (src.owner != owner_point && (src.uvNumbers.size() || src.channel < 1))
+		{
+			RestoreSharedUVs(src, cornerTVerts, map.tverts);
+			return;
+		}
+
+		map.tverts.resize(uvSize * 3);
+		for (int v = 0; v < uvSize; v++)
+		{
+			GetUVW(src, v, &map.tverts[v*3]);
+		}
+	}
+
+	static unsigned short GetFaceMatID( const PartSource& src, int face )
+	{
+		if ( src.mid.size() )
+			return (unsigned short)src.mid[face];
+		else if ( src.allSameMaterial )
+			return 1;
+		return (unsigned short)src.materialIds[face];
+	}
+
+	// order the houdini faces of a part are written in, every converter walks the same order
+	struct FaceOrder
+	{
+		std::vector<int>	faces;			// houdini face per output polygon
+		std::vector<int>	vertexStart;	// first houdini vertex of every houdini face
+	};
+
+	// stable counting sort by material id, triangles of a polygon stay together
+	static void BuildFaceOrder( const PartSource& src, bool sortByMaterial, FaceOrder& order )
+	{
+		const std::vector<int>& polyCount = src.polyCount;
+		int faceCount = (int)polyCount.size();
+
+		order.vertexStart.resize(faceCount);
+		int currentVtxIndex = 0;
+		for ( int i = 0; i < faceCount; ++i )
+		{
+			order.vertexStart[i] = currentVtxIndex;
+			currentVtxIndex += polyCount[i];
+		}
+
+		order.faces.resize(faceCount);
+		int maxId = 0;
+		if ( sortByMaterial && !(src.mid.empty() && src.allSameMaterial) )
+		{
+			for ( int i = 0; i < faceCount; ++i )
+				maxId = std::max(maxId, (int)GetFaceMatID(src, i));
+		}
+		if ( !maxId )
+		{
+			for ( int i = 0; i < faceCount; ++i )
+				order.faces[i] = i;
+			return;
+		}
+
+		std::vector<int> start(maxId + 2, 0);
+		for ( int i = 0; i < faceCount; ++i )
+			start[GetFaceMatID(src, i) + 1]++;
+		for ( int id = 1; id <= maxId + 1; ++id )
+			start[id] += start[id - 1];
+		for ( int i = 0; i < faceCount; ++i )
+			order.faces[start[GetFaceMatID(src, i)]++] = i;
+	}
+
+	// fan triangulation, houdini winding is reversed
+	static void ConvertTriangles( const PartSource& src, const FaceOrder& order, PartBlock& block )
+	{
+		const std::vector<int>& polyCount = src.polyCount;
+		const std::vector<int>& polyConnect = src.polyConnect;
+		int faceCount = (int)polyCount.size();
+
+		int faces = 0;
+		for ( int i = 0; i < faceCount; ++i )
+		{
+			faces += polyCount[i] - 2;
+		}
+		block.faces.resize(faces * 3);
+		block.smGroups.resize(faces);
+		block.matIds.resize(faces);
+		block.edgeVis.resize(faces);
+
+		bool found_sg = src.sg.size() ? true : false;
+		int face = 0;
+		for ( int k = 0; k < faceCount; ++k )
+		{
+			int i = order.faces[k];
+			int currentVtxIndex = order.vertexStart[i];
+			int numPointsInFace = polyCount[i];
+			unsigned short matId = GetFaceMatID(src, i);
+			for ( int j = 0; j < (numPointsInFace-2); j ++ )
+			{
+				block.faces[face*3+0] = polyConnect[currentVtxIndex];
+				block.faces[face*3+1] = polyConnect[currentVtxIndex+j+2];
+				block.faces[face*3+2] = polyConnect[currentVtxIndex+j+1];
+
+				block.smGroups[face] = found_sg ? (unsigned int)src.sg[i] : 1;
+				block.matIds[face] = matId;
+
+				if ( numPointsInFace == 3 )
+					block.edgeVis[face] = 7;	// 1,1,1
+				else if ( j == 0 )
+					block.edgeVis[face] = 6;	// 0,1,1
+				else if ( j == (numPointsInFace-3) )
+					block.edgeVis[face] = 3;	// 1,1,0
+				else
+					block.edgeVis[face] = 2;	// 0,1,0
+				face ++;
+			}
+		}
+	}
+
+	// polygons as they are, corners reversed the same way as the triangle fan
+	static void ConvertPolygons( const PartSource& src, const FaceOrder& order, PartBlock& block )
+	{
+		const std::vector<int>& polyCount = src.polyCount;
+		const std::vector<int>& polyConnect = src.polyConnect;
+		int faceCount = (int)polyCount.size();
+
+		block.polyDegrees.resize(faceCount);
+		block.polyVerts.resize(polyConnect.size());
+		block.smGroups.resize(faceCount);
+		block.matIds.resize(faceCount);
+
+		int corner = 0;
+		bool found_sg = src.sg.size() ? true : false;
+		for ( int k = 0; k < faceCount; ++k )
+		{
+			int i = order.faces[k];
+			int currentVtxIndex = order.vertexStart[i];
+			int numPointsInFace = polyCount[i];
+			for ( int j = 0; j < numPointsInFace; j ++ )
+			{
+				// 0, n-1, n-2 ... 1
+				int src_j = j ? numPointsInFace - j : 0;
+				block.polyVerts[corner+j] = polyConnect[currentVtxIndex+src_j];
+			}
+			block.polyDegrees[k] = numPointsInFace;
+			block.smGroups[k] = found_sg ? (unsigned int)src.sg[i] : 1;
+			block.matIds[k] = GetFaceMatID(src, i);
+			corner += numPointsInFace;
+		}
+	}
+
+	// primitive groups as bitsets, every triangle of a polygon is in its groups
+	static void ConvertGroups( const PartSource& src, const FaceOrder& order, PartBlock& block, bool polygons )
+	{
+		const std::vector<int>& polyCount = src.polyCount;
+		int faceCount = (int)polyCount.size();
+
+		block.groups.resize(src.groups.size());
+		for ( size_t g = 0; g < src.groups.size(); ++g )
+		{
+			const std::vector<int>& membership = src.groups[g].membership;
+			PartGroup& group = block.groups[g];
+			group.name = src.groups[g].name;
+			group.bits.assign(((polygons ? block.numPolys() : block.numFaces()) + 31) / 32, 0);
+
+			int face = 0;
+			for ( int k = 0; k < faceCount; ++k )
+			{
+				int i = order.faces[k];
+				int faces = polygons ? 1 : polyCount[i] - 2;
+				if ( membership[i] )
+				{
+					for ( int j = 0; j < faces; ++j )
+						group.bits[(face + j) >> 5] |= 1u << ((face + j) & 31);
+				}
+				face += faces;
+			}
+		}
+	}
+
+	// one map channel, same face layout as ConvertTriangles / ConvertPolygons
+	static void ConvertMap( const PartSource& src, const FaceOrder& order, const PartUV& uv, PartMap& map, bool polygons )
+	{
+		const std::vector<int>& polyCount = src.polyCount;
+		int faceCount = (int)polyCount.size();
+
+		std::vector<int> cornerTVerts;
+		map.channel = uv.channel;
+		BuildTVerts( src, uv, map, cornerTVerts );
+
+		if ( polygons )
+		{
+			int corner = 0;
+			map.polyTVerts.resize(cornerTVerts.size());
+			for ( int k = 0; k < faceCount; ++k )
+			{
+				int i = order.faces[k];
+				int currentVtxIndex = order.vertexStart[i];
+				int numPointsInFace = polyCount[i];
+				for ( int j = 0; j < numPointsInFace; j ++ )
+				{
+					int src_j = j ? numPointsInFace - j : 0;
+					map.polyTVerts[corner+j] = cornerTVerts[currentVtxIndex+src_j];
+				}
+				corner += numPointsInFace;
+			}
+			return;
+		}
+
+		int faces = 0;
+		for ( int i = 0; i < faceCount; ++i )
+		{
+			faces += polyCount[i] - 2;
+		}
+		map.tvFaces.resize(faces * 3);
+
+		int face = 0;
+		for ( int k = 0; k < faceCount; ++k )
+		{
+			int i = order.faces[k];
+			int currentVtxIndex = order.vertexStart[i];
+			int numPointsInFace = polyCount[i];
+			for ( int j = 0; j < (numPointsInFace-2); j ++ )
+			{
+				map.tvFaces[face*3+0] = cornerTVerts[currentVtxIndex];
+				map.tvFaces[face*3+1] = cornerTVerts[currentVtxIndex+j+2];
+				map.tvFaces[face*3+2] = cornerTVerts[currentVtxIndex+j+1];
+				face ++;
+			}
+		}
+	}
+
+	// cooked N as explicit normals, indexed like the faces or corners
+	static void ConvertPartNormals( const PartSource& src, const FaceOrder& order, PartBlock& block, bool polygons )
+	{
+		const std::vector<int>& polyCount = src.polyCount;
+		const std::vector<int>& polyConnect = src.polyConnect;
+		int faceCount = (int)polyCount.size();
+
+		if ( src.normalOwner == owner_none || src.normals.empty() )
+			return;
+
+		block.normals = src.normals;
+		ConvertNormals( &block.normals.front(), block.numNormals() );
+
+		if ( polygons )
+		{
+			int corner = 0;
+			block.polyNormals.resize(polyConnect.size());
+			for ( int k = 0; k < faceCount; ++k )
+			{
+				int i = order.faces[k];
+				int currentVtxIndex = order.vertexStart[i];
+				int numPointsInFace = polyCount[i];
+				for ( int j = 0; j < numPointsInFace; j ++ )
+				{
+					int src_j = currentVtxIndex + (j ? numPointsInFace - j : 0);
+					block.polyNormals[corner+j] = src.normalOwner == owner_point ? polyConnect[src_j] : src_j;
+				}
+				corner += numPointsInFace;
+			}
+			return;
+		}
+
+		int faces = 0;
+		for ( int i = 0; i < faceCount; ++i )
+		{
+			faces += polyCount[i] - 2;
+		}
+		block.normalFaces.resize(faces * 3);
+
+		int face = 0;
+		for ( int k = 0; k < faceCount; ++k )
+		{
+			int i = order.faces[k];
+			int currentVtxIndex = order.vertexStart[i];
+			int numPointsInFace = polyCount[i];
+			for ( int j = 0; j < (numPointsInFace-2); j ++ )
+			{
+				int c[3] = { currentVtxIndex, currentVtxIndex+j+2, currentVtxIndex+j+1 };
+				for ( int n = 0; n < 3; ++n )
+					block.normalFaces[face*3+n] = src.normalOwner == owner_point ? polyConnect[c[n]] : c[n];
+				face ++;
+			}
+		}
+	}
+
+	// a part without uvs still gets an empty channel 1, after its color channels
+	static const PartUV dummyUV;
+
+	static const PartUV& GetPartUV( const PartSource& src, size_t i )
+	{
+		return i < src.uvs.size() ? src.uvs[i] : dummyUV;
+	}
+
+	static size_t NumPartMaps( const PartSource& src )
+	{
+		return src.uvs.size() && src.uvs.back().channel >= 1 ? src.uvs.size() : src.uvs.size() + 1;
+	}
+
+	void ConvertPart( const PartSource& src, PartBlock& block, bool polygons, bool sortByMaterial )
+	{
+		FaceOrder order;
+		BuildFaceOrder( src, sortByMaterial, order );
+		if ( polygons )
+			ConvertPolygons( src, order, block );
+		else
+			ConvertTriangles( src, order, block );
+		ConvertGroups( src, order, block, polygons );
+		ConvertPartNormals( src, order, block, polygons );
+
+		block.maps.resize( NumPartMaps(src) );
+		for ( size_t i = 0; i < block.maps.size(); ++i )
+			ConvertMap( src, order, GetPartUV(src, i), block.maps[i], polygons );
+	}
+
+	void ConvertParts( const std::vector<const PartSource*>& sources, const std::vector<PartBlock*>& blocks, float scl, bool polygons, bool sortByMaterial, int numThreads )
+	{
+		// the face order is shared by every task of a part
+		std::vector<FaceOrder> orders(sources.size());
+		ParallelFor( (int)sources.size(), [&]( int i )
+		{
+			BuildFaceOrder( *sources[i], sortByMaterial, orders[i] );
+		}, numThreads );
+
+		// task -1 is points and faces of a part, -2 its normals, task n is its n-th map channel
+		std::vector<std::pair<int, int> > tasks;
+		for ( size_t i = 0; i < sources.size(); ++i )
+		{
+			blocks[i]->maps.resize( NumPartMaps(*sources[i]) );
+			tasks.push_back( std::make_pair((int)i, -1) );
+			if ( sources[i]->normals.size() )
+				tasks.push_back( std::make_pair((int)i, -2) );
+			for ( size_t m = 0; m < blocks[i]->maps.size(); ++m )
+				tasks.push_back( std::make_pair((int)i, (int)m) );
+		}
+
+		ParallelFor( (int)tasks.size(), [&]( int t )
+		{
+			const PartSource& src = *sources[tasks[t].first];
+			const FaceOrder& order = orders[tasks[t].first];
+			PartBlock& block = *blocks[tasks[t].first];
+			int m = tasks[t].second;
+			if ( m == -2 )
+			{
+				ConvertPartNormals( src, order, block, polygons );
+			}
+			else if ( m < 0 )
+			{
+				ConvertPoints( block.points.size() ? &block.points.front() : NULL, block.numPoints(), scl );
+				if ( polygons )
+					ConvertPolygons( src, order, block );
+				else
+					ConvertTriangles( src, order, block );
+				ConvertGroups( src, order, block, polygons );
+			}
+			else
+			{
+				ConvertMap( src, order, GetPartUV(src, m), block.maps[m], polygons );
+			}
+		}, numThreads );
+	}
+
+	// faces and points are handed to the workers in chunks, one item per task is too fine
+	static const int normalChunk = 4096;
+
+	static void FaceNormal( const float* points, const int* face, bool clockwise, float* n )
+	{
+		const float* p0 = points + face[0] * 3;
+		const float* p1 = points + face[1] * 3;
+		const float* p2 = points + face[2] * 3;
+		float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+		float len = sqrtf( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+		float s = len > 0.f ? (clockwise ? -1.f : 1.f) / len : 0.f;
+		n[0] *= s;
+		n[1] *= s;
+		n[2] *= s;
+	}
+
+	// normals of the faces around a point that share a smoothing group
+	struct SmoothCluster
+	{
+		unsigned int	sg;
+		float			n[3];
+	};
+
+	void BuildSmoothNormals( const float* points, int numPoints, const int* faces, int numFaces,
+		const unsigned int* smGroups, int smStride, float* normals, bool clockwise, int numThreads )
+	{
+		if ( numFaces <= 0 )
+			return;
+		if ( smStride == 0 )
+			smStride = sizeof(unsigned int);
+		const char* sgBytes = (const char*)smGroups;
+		auto faceSG = [&]( int f ) { return *(const unsigned int*)(sgBytes + (size_t)f * smStride); };
+
+		std::vector<float> faceNormals( (size_t)numFaces * 3 );
+		ParallelForRanges( numFaces, normalChunk, [&]( int begin, int end )
+		{
+			for ( int f = begin; f < end; ++f )
+				FaceNormal( points, faces + f * 3, clockwise, &faceNormals[f * 3] );
+		}, numThreads );
+
+		// corners around every point, in face order
+		std::vector<int> cornerStart( numPoints + 1, 0 );
+		for ( int c = 0; c < numFaces * 3; ++c )
+			++cornerStart[faces[c] + 1];
+		for ( int p = 0; p < numPoints; ++p )
+			cornerStart[p + 1] += cornerStart[p];
+		std::vector<int> corners( numFaces * 3 );
+		{
+			std::vector<int> fill( cornerStart.begin(), cornerStart.end() - 1 );
+			for ( int c = 0; c < numFaces * 3; ++c )
+				corners[fill[faces[c]]++] = c;
+		}
+
+		ParallelForRanges( numPoints, normalChunk, [&]( int begin, int end )
+		{
+			std::vector<SmoothCluster> clusters;
+			for ( int p = begin; p < end; ++p )
+			{
+				// sum the face normals per smoothing group like max's VNormal::AddNormal: a face goes to the
+				// first entry it shares a group with, entries are never merged even when a later face connects them
+				clusters.clear();
+				for ( int i = cornerStart[p]; i < cornerStart[p + 1]; ++i )
+				{
+					int f = corners[i] / 3;
+					unsigned int sg = faceSG(f);
+					if ( !sg )
+						continue;
+					const float* fn = &faceNormals[f * 3];
+					size_t k = 0;
+					while ( k < clusters.size() && !(clusters[k].sg & sg) )
+						++k;
+					if ( k == clusters.size() )
+					{
+						SmoothCluster cl = { 0, { 0.f, 0.f, 0.f } };
+						clusters.push_back(cl);
+					}
+					clusters[k].sg |= sg;
+					clusters[k].n[0] += fn[0];
+					clusters[k].n[1] += fn[1];
+					clusters[k].n[2] += fn[2];
+				}
+				for ( size_t k = 0; k < clusters.size(); ++k )
+				{
+					float* n = clusters[k].n;
+					float len = sqrtf( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+					if ( len > 0.f )
+					{
+						n[0] /= len;
+						n[1] /= len;
+						n[2] /= len;
+					}
+				}
+
+				// a corner takes the last entry that shares a group with its face, as the RVertex lookup in
+				// asciiexp does. faces without a smoothing group keep the face normal, so does a sum that
+				// cancels out where max would give a zero normal
+				for ( int i = cornerStart[p]; i < cornerStart[p + 1]; ++i )
+				{
+					int c = corners[i];
+					unsigned int sg = faceSG(c / 3);
+					const float* n = &faceNormals[(c / 3) * 3];
+					for ( size_t k = clusters.size(); sg && k-- > 0; )
+					{
+						if ( clusters[k].sg & sg )
+						{
+							const float* cn = clusters[k].n;
+							if ( cn[0] != 0.f || cn[1] != 0.f || cn[2] != 0.f )
+								n = cn;
+							break;
+						}
+					}
+					normals[c * 3 + 0] = n[0];
+					normals[c * 3 + 1] = n[1];
+					normals[c * 3 + 2] = n[2];
+				}
+			}
+		}, numThreads );
+	}
+
+	template <class T>
+	static uint64_t HashVector( const std::vector<T>& v, uint64_t seed )
+	{
+		uint64_t size = v.size();
+		seed = Hash64( &size, sizeof(size), seed );
+		return v.empty() ? seed : Hash64( &v.front(), v.size() * sizeof(T), seed );
+	}
+
+	uint64_t HashPartSource( const PartSource& src, uint64_t seed )
+	{
+		int flags[3] = { src.allSameMaterial ? 1 : 0, (int)src.normalOwner, (int)src.uvs.size() };
+		uint64_t h = Hash64( flags, sizeof(flags), seed );
+		h = HashVector( src.polyCount, h );
+		h = HashVector( src.polyConnect, h );
+		h = HashVector( src.sg, h );
+		h = HashVector( src.mid, h );
+		h = HashVector( src.materialIds, h );
+		for ( size_t i = 0; i < src.uvs.size(); ++i )
+		{
+			const PartUV& uv = src.uvs[i];
+			int header[3] = { uv.channel, (int)uv.owner, uv.tupleSize };
+			h = Hash64( header, sizeof(header), h );
+			h = HashVector( uv.uv, h );
+			h = HashVector( uv.uvNumbers, h );
+		}
+		for ( size_t i = 0; i < src.groups.size(); ++i )
+		{
+			const GroupSource& group = src.groups[i];
+			h = Hash64( group.name.c_str(), group.name.size(), h );
+			h = HashVector( group.membership, h );
+		}
+		return h;
+	}
+
+	static void AddKnot( CurveBlock& block, CurveKnotType type, const float* point, const float* inVec, const float* outVec )
+	{
+		CurveKnot knot;
+		knot.type = type;
+		for ( int k = 0; k < 3; ++k )
+		{
+			knot.point[k] = point[k];
+			knot.inVec[k] = inVec[k];
+			knot.outVec[k] = outVec[k];
+		}
+		block.knots.push_back(knot);
+	}
+
+	// cubic segments share their end points: p0 o0 i1 p1 o1 ... , periodic curves wrap to p0.
+	// quadratic segments are raised to cubic, cvs after the last full segment are dropped
+	static void ConvertBezier( const float* cv, int n, int degree, bool periodic, CurveBlock& block )
+	{
+		int segments = periodic ? n / degree : (n - 1) / degree;
+		block.droppedCVs += periodic ? n % degree : (n - 1) % degree;
+		int numKnots = periodic ? segments : segments + 1;
+		for ( int j = 0; j < numKnots; ++j )
+		{
+			const float* p = cv + j * degree * 3;
+			const float* prev = cv + ((j * degree + n - 1) % n) * 3;
+			const float* next = cv + (j * degree + 1) * 3;
+			bool hasIn = j > 0 || periodic;
+			bool hasOut = j < segments;
+			float inVec[3];
+			float outVec[3];
+			for ( int k = 0; k < 3; ++k )
+			{
+				inVec[k] = outVec[k] = p[k];
+				if ( degree == 3 )
+				{
+					if ( hasIn )
+						inVec[k] = prev[k];
+					if ( hasOut )
+						outVec[k] = next[k];
+				}
+				else
+				{
+					if ( hasIn )
+						inVec[k] = p[k] + (prev[k] - p[k]) * (2.f / 3.f);
+					if ( hasOut )
+						outVec[k] = p[k] + (next[k] - p[k]) * (2.f / 3.f);
+				}
+			}
+			AddKnot( block, knot_bezier, p, inVec, outVec );
+		}
+	}
+
+	// point of a b-spline by de boor, u has m + degree + 1 knots
+	static void EvalBSpline( const std::vector<float>& cv, const std::vector<float>& u, int m, int degree, float t, float* out )
+	{
+		int span = degree;
+		while ( span < m - 1 && t >= u[span + 1] )
+			++span;
+
+		float d[16][3];
+		for ( int j = 0; j <= degree; ++j )
+			for ( int k = 0; k < 3; ++k )
+				d[j][k] = cv[(j + span - degree) * 3 + k];
+
+		for ( int r = 1; r <= degree; ++r )
+		{
+			for ( int j = degree; j >= r; --j )
+			{
+				float a = u[j + 1 + span - r] - u[j + span - degree];
+				float alpha = a > 0.f ? (t - u[j + span - degree]) / a : 0.f;
+				for ( int k = 0; k < 3; ++k )
+					d[j][k] = (1.f - alpha) * d[j-1][k] + alpha * d[j][k];
+			}
+		}
+		for ( int k = 0; k < 3; ++k )
+			out[k] = d[degree][k];
+	}
+
+	// sample every knot span, the knots lie on the curve so max can smooth through them
+	static void ConvertNurbs( const float* cv, int n, int degree, bool periodic, const float* knots, int samplesPerSpan, CurveBlock& block )
+	{
+		// periodic curves repeat their first cvs on uniform knots
+		int m = periodic ? n + degree : n;
+		std::vector<float> points(cv, cv + n * 3);
+		for ( int i = n; i < m; ++i )
+			points.insert( points.end(), cv + (i - n) * 3, cv + (i - n) * 3 + 3 );
+
+		std::vector<float> u(m + degree + 1);
+		for ( int i = 0; i < (int)u.size(); ++i )
+		{
+			if ( knots )
+				u[i] = knots[i];
+			else if ( periodic )
+				u[i] = (float)i;
+			else
+				u[i] = (float)std::min(std::max(i - degree, 0), m - degree);
+		}
+
+		for ( int span = degree; span < m; ++span )
+		{
+			float t0 = u[span];
+			float t1 = u[span + 1];
+			if ( t1 <= t0 )
+				continue;
+			for ( int s = 0; s < samplesPerSpan; ++s )
+			{
+				float p[3];
+				EvalBSpline( points, u, m, degree, t0 + (t1 - t0) * s / samplesPerSpan, p );
+				AddKnot( block, knot_smooth, p, p, p );
+			}
+		}
+		if ( !periodic )
+		{
+			float p[3];
+			EvalBSpline( points, u, m, degree, u[m], p );
+			AddKnot( block, knot_smooth, p, p, p );
+		}
+	}
+
+	void ConvertCurves( const CurveSource& src, CurveBlock& block, float scl, int samplesPerSpan )
+	{
+		block.knotCounts.clear();
+		block.knots.clear();
+		block.closed.clear();
+		block.skippedCurves = 0;
+		block.droppedCVs = 0;
+
+		std::vector<float> cvs(src.cvs);
+		if ( cvs.size() )
+			ConvertPoints( &cvs.front(), (int)(cvs.size() / 3), scl );
+
+		int cvOfs = 0;
+		int knotOfs = 0;
+		for ( size_t c = 0; c < src.counts.size(); ++c )
+		{
+			int n = src.counts[c];
+			int order = src.order ? src.order : (c < src.orders.size() ? src.orders[c] : 4);
+			// a single cv is no spline, counts that run past the cvs have nothing to convert
+			if ( n < 2 || (size_t)(cvOfs + n) * 3 > cvs.size() )
+			{
+				knotOfs += std::max(n, 0) + order;
+				cvOfs += std::max(n, 0);
+				block.skippedCurves++;
+				continue;
+			}
+			const float* cv = cvs.data() + cvOfs * 3;
+			size_t first = block.knots.size();
+
+			// nurbs knots are only taken when every open curve brings n + order of them
+			const float* knots = NULL;
+			if ( src.type == curve_nurbs && !src.periodic && src.knots.size() >= (size_t)(knotOfs + n + order) )
+				knots = &src.knots[knotOfs];
+			knotOfs += n + order;
+
+			int degree = std::min(order - 1, std::min(n - 1, 15));
+			if ( src.type == curve_linear || degree <= 1 )
+			{
+				for ( int i = 0; i < n; ++i )
+					AddKnot( block, knot_corner, cv + i * 3, cv + i * 3, cv + i * 3 );
+			}
+			else if ( src.type == curve_bezier && degree <= 3 )
+				ConvertBezier( cv, n, degree, src.periodic, block );
+			else if ( src.type == curve_bezier )
+			{
+				// higher degree bezier is a b-spline with every segment end repeated degree times
+				std::vector<float> bezierKnots;
+				if ( !src.periodic )
+				{
+					int segments = (n - 1) / degree;
+					bezierKnots.assign(degree + 1, 0.f);
+					for ( int i = 1; i < segments; ++i )
+						bezierKnots.insert( bezierKnots.end(), degree, (float)i );
+					bezierKnots.insert( bezierKnots.end(), degree + 1, (float)segments );
+				}
+				ConvertNurbs( cv, n, degree, src.periodic, bezierKnots.size() == (size_t)(n + degree + 1) ? &bezierKnots.front() : NULL, samplesPerSpan, block );
+			}
+			else
+				ConvertNurbs( cv, n, degree, src.periodic, degree == order - 1 ? knots : NULL, samplesPerSpan, block );
+
+			block.knotCounts.push_back( (int)(block.knots.size() - first) );
+			block.closed.push_back( src.periodic );
+			cvOfs += n;
+		}
+	}
+};
@@ -0,0 +1,203 @@
+#ifndef __HOUDINIENGINE_CONVERT__
+#define __HOUDINIENGINE_CONVERT__
+
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include "HoudiniEngine_cache.h"
+
+// where a point, vertex or primitive attribute lives
+enum AttribOwner
+{
+	owner_none,
+	owner_point,
+	owner_vertex,
+	owner_prim
+};
+
+// map channel attribute of a part, uv is channel 1, uv2..uv99 are channel 2..99,
+// Cd is channel 0 and Alpha is channel -2 (MAP_ALPHA)
+struct PartUV
+{
+	PartUV() : channel(1), owner(owner_none), tupleSize(3) {}
+
+	int					channel;
+	AttribOwner			owner;
+	int					tupleSize;
+	std::vector<float>	uv;				// tupleSize floats per point, vertex or primitive
+	std::vector<int>	uvNumbers;		// uvNumber per vertex, may be empty
+};
+
+// primitive group of a part
+struct GroupSource
+{
+	std::string			name;
+	std::vector<int>	membership;		// 0 or 1 per face
+};
+
+// raw part data as fetched from houdini engine, no max or hapi types so it can be converted on any thread
+struct PartSource
+{
+	PartSource() : allSameMaterial(true), normalOwner(owner_none) {}
+
+	std::vector<int>	polyCount;		// vertices per face
+	std::vector<int>	polyConnect;	// point per vertex
+	std::vector<int>	sg;				// max_sg per face, may be empty
+	std::vector<int>	mid;			// max_mid per face, may be empty
+	std::vector<int>	materialIds;	// houdini material per face
+	bool				allSameMaterial;
+	std::vector<PartUV>	uvs;			// sorted by channel, without a uv channel a dummy channel 1 is added
+	AttribOwner			normalOwner;
+	std::vector<float>	normals;		// N per point or vertex
+	std::vector<GroupSource>	groups;	// primitive groups, sorted by name
+};
+
+// same order as HAPI_CurveType
+enum CurveType
+{
+	curve_linear,
+	curve_nurbs,
+	curve_bezier
+};
+
+// raw curve part as fetched from houdini engine
+struct CurveSource
+{
+	CurveSource() : type(curve_linear), periodic(false), order(0) {}
+
+	CurveType			type;
+	bool				periodic;
+	int					order;		// 0 = per curve in orders
+	std::vector<int>	counts;		// cvs per curve
+	std::vector<int>	orders;		// order per curve, may be empty
+	std::vector<float>	cvs;		// xyz per cv
+	std::vector<float>	knots;		// nurbs knots of every curve, empty = uniform
+};
+
+enum CurveKnotType
+{
+	knot_corner,	// in/out vectors equal the point
+	knot_bezier,
+	knot_smooth		// point on the curve, tangents are left to max
+};
+
+// bezier knot of a converted curve, max coordinate system
+struct CurveKnot
+{
+	CurveKnotType	type;
+	float			point[3];
+	float			inVec[3];
+	float			outVec[3];
+};
+
+// curves of a part as bezier splines
+struct CurveBlock
+{
+	CurveBlock() : skippedCurves(0), droppedCVs(0) {}
+
+	std::vector<int>		knotCounts;	// knots per curve
+	std::vector<CurveKnot>	knots;
+	std::vector<bool>		closed;		// per curve
+	int						skippedCurves;	// fewer than 2 cvs, or counts that run past the cvs
+	int						droppedCVs;		// trailing bezier cvs that do not fill a segment
+
+	int numCurves() const { return (int)knotCounts.size(); }
+};
+
+namespace util
+{
+	// open addressing table keyed on (uvNumber, u, v, w), linear probing. restores the shared uvs of a part,
+	// indices are handed out in insertion order
+	class UVTable
+	{
+	public:
+		UVTable( size_t count )
+		{
+			size_t capacity = 16;
+			while ( capacity < count * 2 )
+				capacity <<= 1;
+			mask = capacity - 1;
+			slots.resize(capacity);
+		}
+
+		// index of an equal uvw, or newIndex after inserting it
+		int insert( int uvNumber, const float* uvw, int newIndex )
+		{
+			// -0 and 0 compare equal, so they have to hash the same
+			float u = uvw[0] + 0.f;
+			float v = uvw[1] + 0.f;
+			float w = uvw[2] + 0.f;
+			uint32_t ub, vb, wb;
+			memcpy(&ub, &u, sizeof(ub));
+			memcpy(&vb, &v, sizeof(vb));
+			memcpy(&wb, &w, sizeof(wb));
+
+			uint64_t h = (uint64_t)(uint32_t)uvNumber * 0x9E3779B185EBCA87ULL;
+			h ^= ((uint64_t)ub << 32 | vb) * 0xC2B2AE3D27D4EB4FULL;
+			h ^= (uint64_t)wb * 0x165667B19E3779F9ULL;
+			h ^= h >> 29;
+
+			for ( size_t i = (size_t)h & mask; ; i = (i + 1) & mask )
+			{
+				Slot& slot = slots[i];
+				if ( slot.index < 0 )
+				{
+					slot.uvNumber = uvNumber;
+					slot.u = u;
+					slot.v = v;
+					slot.w = w;
+					slot.index = newIndex;
+					return newIndex;
+				}
+				if ( slot.uvNumber == uvNumber && slot.u == u && slot.v == v && slot.w == w )
+					return slot.index;
+			}
+		}
+
+	private:
+		struct Slot
+		{
+			Slot() : uvNumber(0), u(0.f), v(0.f), w(0.f), index(-1) {}
+			int		uvNumber;
+			float	u;
+			float	v;
+			float	w;
+			int		index;
+		};
+		std::vector<Slot>	slots;
+		size_t				mask;
+	};
+
+	// houdini y-up positions to max z-up, in place
+	void ConvertPoints( float* points, int count, float scl );
+
+	// houdini y-up directions to max z-up, in place
+	void ConvertNormals( float* normals, int count );
+
+	// triangulate faces, or keep them as polygons, and build smoothing groups, material ids,
+	// edge visibility and map channels. block.points is left untouched.
+	// sortByMaterial writes the faces stably sorted by material id, so max draws fewer batches
+	void ConvertPart( const PartSource& src, PartBlock& block, bool polygons = false, bool sortByMaterial = false );
+
+	// convert every source into the block with the same index on a pool of worker threads,
+	// map channels are converted as separate tasks. points of every block are converted as well
+	void ConvertParts( const std::vector<const PartSource*>& sources, const std::vector<PartBlock*>& blocks, float scl, bool polygons = false, bool sortByMaterial = false, int numThreads = 0 );
+
+	// per corner normals of a triangle mesh as max builds them from smoothing groups: around a point, a face is
+	// added to the first normal it shares a group with, and a corner takes the last one it shares a group with.
+	// face normals are normalized before they are summed, faces without a group keep their face normal.
+	// faces holds 3 points per triangle, normals gets xyz per corner in the same order. smStride is the byte
+	// distance between smoothing groups, 0 = packed. clockwise if the faces are wound the other way than the normals
+	void BuildSmoothNormals( const float* points, int numPoints, const int* faces, int numFaces,
+		const unsigned int* smGroups, int smStride, float* normals, bool clockwise = false, int numThreads = 0 );
+
+	// hash of everything in src except the normals, those are hashed with the points
+	uint64_t HashPartSource( const PartSource& src, uint64_t seed = 0 );
+
+	// linear and bezier curves are kept as they are, nurbs are sampled per knot span.
+	// what can not be converted is counted in the block, not converted
+	void ConvertCurves( const CurveSource& src, CurveBlock& block, float scl, int samplesPerSpan = 8 );
+};
+
+#endif // __HOUDINIENGINE_CONVERT__
@@ -0,0 +1,108 @@
+#include <string.h>
+#include "HoudiniEngine_hash.h"
+
+namespace util
+{
+	static const uint64_t PRIME64_1 = 11400714785074694791ULL;
+	static const uint64_t PRIME64_2 = 14029467366897019727ULL;
+	static const uint64_t PRIME64_3 =  1609587929392839161ULL;
+	static const uint64_t PRIME64_4 =  9650029242287828579ULL;
+	static const uint64_t PRIME64_5 =  2870177450012600261ULL;
+
+	static inline uint64_t Rotl64( uint64_t x, int r )
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	static inline uint64_t Read64( const unsigned char* p )
+	{
+		uint64_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	static inline uint32_t Read32( const unsigned char* p )
+	{
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	static inline uint64_t Round( uint64_t acc, uint64_t input )
+	{
+		acc += input * PRIME64_2;
+		acc  = Rotl64(acc, 31);
+		acc *= PRIME64_1;
+		return acc;
+	}
+
+	static inline uint64_t MergeRound( uint64_t acc, uint64_t val )
+	{
+		val  = Round(0, val);
+		acc ^= val;
+		acc  = acc * PRIME64_1 + PRIME64_4;
+		return acc;
+	}
+
+	uint64_t Hash64( const void* data, size_t length, uint64_t seed )
+	{
+		const unsigned char* p = (const unsigned char*)data;
+		const unsigned char* end = p + length;
+		uint64_t h;
+
+		if ( length >= 32 )
+		{
+			const unsigned char* limit = end - 32;
+			uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+			uint64_t v2 = seed + PRIME64_2;
+			uint64_t v3 = seed + 0;
+			uint64_t v4 = seed - PRIME64_1;
+
+			do {
+				v1 = Round(v1, Read64(p)); p += 8;
+				v2 = Round(v2, Read64(p)); p += 8;
+				v3 = Round(v3, Read64(p)); p += 8;
+				v4 = Round(v4, Read64(p)); p += 8;
+			} while ( p <= limit );
+
+			h = Rotl64(v1, 1) + Rotl64(v2, 7) + Rotl64(v3, 12) + Rotl64(v4, 18);
+			h = MergeRound(h, v1);
+			h = MergeRound(h, v2);
+			h = MergeRound(h, v3);
+			h = MergeRound(h, v4);
+		}
+		else
+		{
+			h = seed + PRIME64_5;
+		}
+
+		h += (uint64_t)length;
+
+		while ( p + 8 <= end )
+		{
+			uint64_t k1 = Round(0, Read64(p));
+			h ^= k1;
+			h  = Rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+			p += 8;
+		}
+		if ( p + 4 <= end )
+		{
+			h ^= (uint64_t)Read32(p) * PRIME64_1;
+			h  = Rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+			p += 4;
+		}
+		while ( p < end )
+		{
+			h ^= (*p) * PRIME64_5;
+			h  = Rotl64(h, 11) * PRIME64_1;
+			p ++;
+		}
+
+		h ^= h >> 33;
+		h *= PRIME64_2;
+		h ^= h >> 29;
+		h *= PRIME64_3;
+		h ^= h >> 32;
+		return h;
+	}
+};
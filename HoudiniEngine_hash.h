@@ -0,0 +1,13 @@
+#ifndef __HOUDINIENGINE_HASH__
+#define __HOUDINIENGINE_HASH__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace util
+{
+	// 64bit xxHash of a buffer
+	uint64_t Hash64( const void* data, size_t length, uint64_t seed = 0 );
+};
+
+#endif // __HOUDINIENGINE_HASH__
@@ -2,4 +2,5 @@
 
 #define HOUDINIENGINE_MESH_CLASS_ID		Class_ID(0x986df9b4, 0x792ce6d7)
 #define HOUDINIENGINE_MOD_CLASS_ID		Class_ID(0x511e2359, 0x7496447f)
+#define HOUDINIENGINE_OBJECT_CLASS_ID	Class_ID(0x3c5a1e72, 0x5f0b9d41)
 
@@ -1,7 +1,10 @@
-#include <sstream>
 #include "HoudiniEngine.h"
 #include "HoudiniEngine_input.h"
 #include "HoudiniEngine_util.h"
+#include "HoudiniEngine_xform.h"
+#include "HoudiniEngine_convert.h"
+#include "HoudiniEngine_parallel.h"
+#include "HoudiniEngine_hash.h"
 #include <Simpobj.h>
 #include <particle.h>
 #include <IParticleObjectExt.h>
@@ -12,7 +15,172 @@ public:
 	NullView() { worldToView.IdentityMatrix(); screenW=640.0f; screenH = 480.0f; }
 };
 
-HAPI_AssetId InputMesh( int asset_id, int input_id, INode* node, TimeValue t, Matrix3 &baseTM, double scale, InputAsset* iasset = NULL )
+// one upload of the input geo, arrays are hashed against the last commit of iasset
+// and only sent if they changed. without iasset everything is sent
+class GeoUpload
+{
+public:
+	GeoUpload( HAPI_AssetId asset, InputAsset* iasset ) : asset(asset), iasset(iasset), changed(false)
+	{
+		if ( iasset )
+			previous.swap( iasset->attributeHashes );
+	}
+
+	// point count, face counts and vertex list. a change resets the geo, every attribute is sent again
+	void setTopology( const HAPI_PartInfo& partInfo, const std::vector<int>& fc, const std::vector<int>& vl )
+	{
+		uint64_t h = util::Hash64( &partInfo.pointCount, sizeof(partInfo.pointCount) );
+		if ( fc.size() )
+			h = util::Hash64( &fc.front(), fc.size() * sizeof(int), h );
+		if ( vl.size() )
+			h = util::Hash64( &vl.front(), vl.size() * sizeof(int), h );
+		if ( iasset && iasset->topologyHash == h )
+			return;
+
+		if ( iasset )
+			iasset->topologyHash = h;
+		previous.clear();
+		HAPI_SetPartInfo(hapi::Engine::instance()->session(), asset, 0, 0, &partInfo);
+		if ( fc.size() )
+		{
+			HAPI_SetFaceCounts(hapi::Engine::instance()->session(), asset, 0, 0, &fc.front(), 0, partInfo.faceCount);
+			HAPI_SetVertexList(hapi::Engine::instance()->session(), asset, 0, 0, &vl.front(), 0, partInfo.vertexCount);
+		}
+		changed = true;
+	}
+
+	// curve part: point count, curve type and cvs per curve. a change resets the geo like setTopology
+	void setCurves( const HAPI_PartInfo& partInfo, const HAPI_CurveInfo& curveInfo, const std::vector<int>& counts )
+	{
+		int header[4] = { partInfo.pointCount, (int)curveInfo.curveType, curveInfo.order, curveInfo.isPeriodic ? 1 : 0 };
+		uint64_t h = util::Hash64( header, sizeof(header), HAPI_PARTTYPE_CURVE );
+		if ( counts.size() )
+			h = util::Hash64( &counts.front(), counts.size() * sizeof(int), h );
+		if ( iasset && iasset->topologyHash == h )
+			return;
+
+		if ( iasset )
+			iasset->topologyHash = h;
+		previous.clear();
+		HAPI_SetPartInfo(hapi::Engine::instance()->session(), asset, 0, 0, &partInfo);
+		HAPI_SetCurveInfo(hapi::Engine::instance()->session(), asset, 0, 0, 0, &curveInfo);
+		if ( counts.size() )
+			HAPI_SetCurveCounts(hapi::Engine::instance()->session(), asset, 0, 0, 0, &counts.front(), 0, (int)counts.size());
+		changed = true;
+	}
+
+	void setFloat( const char* name, HAPI_AttributeOwner owner, int count, int tupleSize, const std::vector<float>& data )
+	{
+		bool added;
+		if ( !needsUpload( name, data, added ) )
+			return;
+
+		HAPI_AttributeInfo attributeInfo = getInfo( owner, HAPI_STORAGETYPE_FLOAT, count, tupleSize );
+		if ( !added )
+			HAPI_AddAttribute(hapi::Engine::instance()->session(), asset, 0, 0, name, &attributeInfo);
+		HAPI_SetAttributeFloatData(hapi::Engine::instance()->session(), asset, 0, 0, name, &attributeInfo, &data.front(), 0, count);
+	}
+
+	void setInt( const char* name, HAPI_AttributeOwner owner, int count, int tupleSize, const std::vector<int>& data )
+	{
+		bool added;
+		if ( !needsUpload( name, data, added ) )
+			return;
+
+		HAPI_AttributeInfo attributeInfo = getInfo( owner, HAPI_STORAGETYPE_INT, count, tupleSize );
+		if ( !added )
+			HAPI_AddAttribute(hapi::Engine::instance()->session(), asset, 0, 0, name, &attributeInfo);
+		HAPI_SetAttributeIntData(hapi::Engine::instance()->session(), asset, 0, 0, name, &attributeInfo, &data.front(), 0, count);
+	}
+
+	// commit if anything was sent. false if an attribute of the last commit was not set again,
+	// it cannot be removed from the geo so the caller has to send everything again
+	bool commit()
+	{
+		if ( previous.size() )
+		{
+			if ( iasset )
+				iasset->resetUpload();
+			return false;
+		}
+		if ( changed )
+			HAPI_CommitGeo(hapi::Engine::instance()->session(), asset, 0, 0);
+		return true;
+	}
+
+private:
+	static HAPI_AttributeInfo getInfo( HAPI_AttributeOwner owner, HAPI_StorageType storage, int count, int tupleSize )
+	{
+		HAPI_AttributeInfo attributeInfo;
+		attributeInfo.exists    = true;
+		attributeInfo.owner     = owner;
+		attributeInfo.storage   = storage;
+		attributeInfo.count     = count;
+		attributeInfo.tupleSize = tupleSize;
+		return attributeInfo;
+	}
+
+	// added is true if the attribute already exists on the geo
+	template <class T>
+	bool needsUpload( const char* name, const std::vector<T>& data, bool& added )
+	{
+		added = false;
+		if ( data.empty() )
+			return false;
+
+		uint64_t h = util::Hash64( &data.front(), data.size() * sizeof(T) );
+		std::map<std::string, uint64_t>::iterator it = previous.find(name);
+		if ( it != previous.end() )
+		{
+			added = true;
+			bool same = it->second == h;
+			previous.erase(it);
+			if ( iasset )
+				iasset->attributeHashes[name] = h;
+			if ( same )
+				return false;
+		}
+		else if ( iasset )
+			iasset->attributeHashes[name] = h;
+		changed = true;
+		return true;
+	}
+
+	HAPI_AssetId						asset;
+	InputAsset*							iasset;
+	std::map<std::string, uint64_t>		previous;	// hashes of the last commit that were not set again yet
+	bool								changed;
+};
+
+// relative transform of an input. baked, the points are moved into the space of the asset node,
+// otherwise it is set on the object of the input asset and the points stay in object space so
+// moving a node does not send the geometry again. returns the transform for the points
+static Matrix3 SetInputTransform( HAPI_AssetId asset, InputAsset* iasset, const Matrix3& toLocalSpace, float scl, bool bake )
+{
+	float m[16];
+	bool baked = bake || !util::GetHoudiniMatrix( toLocalSpace, scl, m );
+	if ( baked )
+	{
+		memset( m, 0, sizeof(m) );
+		m[0] = m[5] = m[10] = m[15] = 1.f;
+	}
+
+	uint64_t h = util::Hash64( m, sizeof(m) );
+	if ( !iasset || iasset->transformHash != h )
+	{
+		HAPI_TransformEuler transform;
+		HAPI_ConvertMatrixToEuler(hapi::Engine::instance()->session(), m, HAPI_SRT, HAPI_XYZ, &transform);
+		HAPI_SetObjectTransform(hapi::Engine::instance()->session(), asset, 0, &transform);
+		if ( iasset )
+			iasset->transformHash = h;
+	}
+	return baked ? toLocalSpace : Matrix3(1);
+}
+
+// faces and points per task of the input packing
+static const int packChunk = 4096;
+
+HAPI_AssetId InputMesh( int asset_id, int input_id, INode* node, TimeValue t, Matrix3 &baseTM, double scale, InputAsset* iasset = NULL, bool bakeTransform = false )
 {
 	HAPI_AssetId asset;
 
@@ -24,16 +192,17 @@ HAPI_AssetId InputMesh( int asset_id, int input_id, INode* node, TimeValue t, Ma
 	else
 	{
 		HAPI_CreateInputAsset(hapi::Engine::instance()->session(), &asset, NULL);
+		if ( iasset )
+			iasset->resetUpload();
 	}
 
 	Object *pobj = node->EvalWorldState(t).obj;
 	BOOL needDel;
 	NullView nullView;
 	Mesh *msh = ((GeomObject*)pobj)->GetRenderMesh(t,node,nullView,needDel);
-	msh->buildNormals();
 
 	Matrix3 objectTM = node->GetObjectTM(t);
-	Matrix3 toLocalSpace = objectTM * Inverse(baseTM);
+	Matrix3 toLocalSpace = SetInputTransform( asset, iasset, objectTM * Inverse(baseTM), (float)scale, bakeTransform );
 	Matrix3 toLocalSpaceR = toLocalSpace;
 	toLocalSpaceR.SetTrans(Point3());
 
@@ -45,181 +214,123 @@ HAPI_AssetId InputMesh( int asset_id, int input_id, INode* node, TimeValue t, Ma
     partInfo.vertexCount      = msh->numFaces*3;
     partInfo.pointCount       = msh->numVerts;
 
-    // copy data to arrays
+	// map channels that are sent, uv range 1 to (MAX_MESHMAPS-1)
+	std::vector<int> maps;
 	{
-		std::vector<int> vl;
-		std::vector<int> fc;
-		std::vector<float> pt;
-
-		vl.reserve( partInfo.vertexCount );
-		fc.reserve( partInfo.faceCount );
-		pt.reserve( partInfo.pointCount*3 );
-
-		// convert unit scaling
-		float scl = (float)scale;
-		// build vertex and face count
-		for ( int i = 0; i < msh->numFaces; ++i )
+		int useMaps = 0;
+		for (int i = 1; useMaps < msh->getNumMaps() && i < MAX_MESHMAPS; ++i)
 		{
-			fc.push_back( 3 );
-			for ( int j = 2; j >= 0; --j )
+			if (msh->mapSupport(i))
 			{
-	    		vl.push_back( msh->faces[i].v[j] );
+				if (msh->getNumMapVerts(i))
+					maps.push_back(i);
+				useMaps++;
 			}
 		}
-		for ( int i = 0; i < msh->numVerts; ++i )
-		{
-			Point3 p = msh->verts[i] * toLocalSpace;
-			float y = p.y;
-			p.y = p.z;
-			p.z = -y;
-			p *= scl;
-
-			pt.push_back( p.x );
-			pt.push_back( p.y );
-			pt.push_back( p.z );
-		}
-		// Set the data
-		HAPI_SetPartInfo(hapi::Engine::instance()->session(), asset, 0, 0, &partInfo);
-		HAPI_SetFaceCounts(hapi::Engine::instance()->session(), asset, 0, 0, &fc.front(), 0, partInfo.faceCount);
-		HAPI_SetVertexList(hapi::Engine::instance()->session(), asset, 0, 0, &vl.front(), 0, partInfo.vertexCount);
-		// Set position attributes.
-		HAPI_AttributeInfo pos_attr_info;
-		pos_attr_info.exists             = true;
-		pos_attr_info.owner              = HAPI_ATTROWNER_POINT;
-		pos_attr_info.storage            = HAPI_STORAGETYPE_FLOAT;
-		pos_attr_info.count              = partInfo.pointCount;
-		pos_attr_info.tupleSize          = 3;
-		HAPI_AddAttribute(hapi::Engine::instance()->session(), asset, 0, 0, "P", &pos_attr_info);
-		HAPI_SetAttributeFloatData(hapi::Engine::instance()->session(), asset, 0, 0, "P", &pos_attr_info, &pt.front(), 0, partInfo.pointCount);
-	}
-	// normals
-    {
+	}
 
-        // build the per-vertex normals
-        std::vector<float> vertexNormals;
-        vertexNormals.reserve(partInfo.vertexCount * 3);
+	// every array is sized up front and filled over face ranges on worker threads,
+	// only the HAPI calls stay on this thread
+	int numFaces = msh->numFaces;
+	std::vector<int> fc( numFaces );
+	std::vector<int> vl( partInfo.vertexCount );
+	std::vector<float> pt( partInfo.pointCount*3 );
+	std::vector<float> vertexNormals( partInfo.vertexCount*3 );
+	std::vector<int> sg( numFaces );
+	std::vector<int> mid( numFaces );
+	std::vector< std::vector<float> > uvv( maps.size() );
+	std::vector< std::vector<int> > uvn( maps.size() );
+	for ( size_t m = 0; m < maps.size(); ++m )
+	{
+		uvv[m].resize( partInfo.vertexCount*3 );
+		uvn[m].resize( partInfo.vertexCount );
+	}
 
-		for ( int i = 0; i < msh->numFaces; ++i )
+	util::ParallelForRanges( numFaces, packChunk, [&]( int begin, int end )
+	{
+		for ( int i = begin; i < end; ++i )
 		{
-			for ( int j = 2; j >= 0; --j )
-			{
-	    		int vi = msh->faces[i].v[j];
-				Point3 vn = util::GetVertexNormal(msh, i, msh->getRVertPtr(vi)) * toLocalSpaceR;
-				vertexNormals.push_back(vn.x);
-				vertexNormals.push_back(vn.z);
-				vertexNormals.push_back(-vn.y);
-			}
-        }
-
-        // add and set it to HAPI
-        HAPI_AttributeInfo attributeInfo;
-        attributeInfo.exists = true;
-        attributeInfo.owner = HAPI_ATTROWNER_VERTEX;
-        attributeInfo.storage = HAPI_STORAGETYPE_FLOAT;
-        attributeInfo.count = partInfo.vertexCount;
-        attributeInfo.tupleSize = 3;
-		HAPI_AddAttribute(hapi::Engine::instance()->session(), asset, 0, 0, "N", &attributeInfo);
-		HAPI_SetAttributeFloatData(hapi::Engine::instance()->session(), asset, 0, 0, "N", &attributeInfo,
-                &vertexNormals.front(), 0, partInfo.vertexCount);
-    }
-	// uv
-	{
-		// uv range 1 to (MAX_MESHMAPS-1)
-		int useMaps = 0;
-		for (int i = 1; useMaps < msh->getNumMaps() && i < MAX_MESHMAPS; ++i)
+			Face& face = msh->faces[i];
+			fc[i] = 3;
+			for ( int j = 0; j < 3; ++j )
+				vl[i*3+j] = (int)face.v[2-j];
+			sg[i] = (int)face.smGroup;
+			mid[i] = (int)face.getMatID();
+		}
+		for ( size_t m = 0; m < maps.size(); ++m )
 		{
-			if (msh->mapSupport(i))
+			const TVFace* tf = msh->mapFaces(maps[m]);
+			const UVVert* tv = msh->mapVerts(maps[m]);
+			for ( int i = begin; i < end; ++i )
 			{
-				if (msh->getNumMapVerts(i))
+				for ( int j = 0; j < 3; ++j )
 				{
-					std::string uvName;
-					std::string uvNumberName;
-					uvName = i == 1 ? std::string("uv") : std::string("uv") + std::to_string(i);
-					uvNumberName = i == 1 ? std::string("uvNumber") : std::string("uvNumber") + std::to_string(i);
-
-					std::vector<int> uvn;
-					std::vector<float> uvv;
-
-					for (int f = 0; f < msh->numFaces; ++f)
-					{
-						for (int deg = 3-1; deg >= 0; --deg)
-						{
-							int vv = msh->mapFaces(i)[f].getTVert(deg);
-							uvv.push_back(msh->mapVerts(i)[vv].x);
-							uvv.push_back(msh->mapVerts(i)[vv].y);
-							uvv.push_back(0.0f);
-							uvn.push_back(vv);
-						}
-					}
-
-					if (partInfo.vertexCount == uvn.size())
-					{
-						// add and set it to HAPI
-						HAPI_AttributeInfo attributeInfo;
-						attributeInfo.exists = true;
-						attributeInfo.owner = HAPI_ATTROWNER_VERTEX;
-						attributeInfo.storage = HAPI_STORAGETYPE_FLOAT;
-						attributeInfo.count = partInfo.vertexCount;
-						attributeInfo.tupleSize = 3;
-						HAPI_AddAttribute(hapi::Engine::instance()->session(), asset, 0, 0, uvName.c_str(), &attributeInfo);
-						HAPI_SetAttributeFloatData(hapi::Engine::instance()->session(), asset, 0, 0, uvName.c_str(), &attributeInfo,
-							&uvv.front(), 0, partInfo.vertexCount);
-
-						attributeInfo.storage = HAPI_STORAGETYPE_INT;
-						attributeInfo.count = partInfo.vertexCount;
-						attributeInfo.tupleSize = 1;
-						HAPI_AddAttribute(hapi::Engine::instance()->session(), asset, 0, 0, uvNumberName.c_str(), &attributeInfo);
-						HAPI_SetAttributeIntData(hapi::Engine::instance()->session(), asset, 0, 0, uvNumberName.c_str(), &attributeInfo,
-							&uvn.front(), 0, partInfo.vertexCount);
-					}
+					int vv = (int)tf[i].t[2-j];
+					float* uv = &uvv[m][(i*3+j)*3];
+					uv[0] = tv[vv].x;
+					uv[1] = tv[vv].y;
+					uv[2] = 0.0f;
+					uvn[m][i*3+j] = vv;
 				}
-				useMaps++;
 			}
 		}
+	} );
+
+	if ( msh->numVerts )
+	{
+		// convert unit scaling
+		util::Affine34 m;
+		util::GetHoudiniTransform( toLocalSpace, (float)scale, m );
+		util::ParallelForRanges( msh->numVerts, packChunk, [&]( int begin, int end )
+		{
+			util::TransformPoints( &msh->verts[begin].x, &pt[begin*3], end - begin, m );
+		} );
 	}
-	// smooting group and material id
+
+	// per-vertex normals straight from the smoothing groups, vl is wound clockwise in max space.
+	// Mesh::buildNormals and a RVertex lookup per corner were the slowest part of a large mesh
+	if ( numFaces )
 	{
-		std::vector<int>	sg;
-		std::vector<int>	mid;
-		sg.reserve( partInfo.faceCount );
-		mid.reserve( partInfo.faceCount );
+		util::BuildSmoothNormals( &msh->verts[0].x, msh->numVerts, &vl.front(), numFaces,
+			(const unsigned int*)&msh->faces[0].smGroup, sizeof(Face), &vertexNormals.front(), true );
 
-		for ( int i = 0; i < msh->numFaces; ++i )
+		util::Affine34 m;
+		util::GetHoudiniTransform( toLocalSpaceR, 1.f, m );
+		util::ParallelForRanges( partInfo.vertexCount, packChunk, [&]( int begin, int end )
 		{
-			for ( int j = 0; j < 3; ++j )
-			{
-	    		sg.push_back( (int)msh->faces[i].getSmGroup() );
-	    		mid.push_back( (int)msh->faces[i].getMatID() );
-			}
-        }
-        HAPI_AttributeInfo attributeInfo;
-        attributeInfo.exists = true;
-        attributeInfo.owner = HAPI_ATTROWNER_PRIM;
-        attributeInfo.storage = HAPI_STORAGETYPE_INT;
-        attributeInfo.count = msh->numFaces;
-        attributeInfo.tupleSize = 1;
-		HAPI_AddAttribute(hapi::Engine::instance()->session(), asset, 0, 0, "max_sg", &attributeInfo);
-		HAPI_SetAttributeIntData(hapi::Engine::instance()->session(), asset, 0, 0, "max_sg", &attributeInfo,
-                &sg.front(), 0, msh->numFaces);
-        attributeInfo.exists = true;
-        attributeInfo.owner = HAPI_ATTROWNER_PRIM;
-        attributeInfo.storage = HAPI_STORAGETYPE_INT;
-        attributeInfo.count = msh->numFaces;
-        attributeInfo.tupleSize = 1;
-		HAPI_AddAttribute(hapi::Engine::instance()->session(), asset, 0, 0, "max_mid", &attributeInfo);
-		HAPI_SetAttributeIntData(hapi::Engine::instance()->session(), asset, 0, 0, "max_mid", &attributeInfo,
-                &mid.front(), 0, msh->numFaces);
-	}
-
-	HAPI_CommitGeo(hapi::Engine::instance()->session(), asset, 0, 0);
-	HAPI_ConnectAssetGeometry(hapi::Engine::instance()->session(), asset, 0, asset_id, input_id);
+			util::TransformPoints( &vertexNormals[begin*3], &vertexNormals[begin*3], end - begin, m );
+		} );
+	}
+
+	GeoUpload upload( asset, iasset );
+	// Set the data, the topology only if it changed since the last commit
+	upload.setTopology( partInfo, fc, vl );
+	upload.setFloat( "P", HAPI_ATTROWNER_POINT, partInfo.pointCount, 3, pt );
+	upload.setFloat( "N", HAPI_ATTROWNER_VERTEX, partInfo.vertexCount, 3, vertexNormals );
+	for ( size_t m = 0; m < maps.size(); ++m )
+	{
+		int i = maps[m];
+		std::string uvName = i == 1 ? std::string("uv") : std::string("uv") + std::to_string(i);
+		std::string uvNumberName = i == 1 ? std::string("uvNumber") : std::string("uvNumber") + std::to_string(i);
+		upload.setFloat( uvName.c_str(), HAPI_ATTROWNER_VERTEX, partInfo.vertexCount, 3, uvv[m] );
+		upload.setInt( uvNumberName.c_str(), HAPI_ATTROWNER_VERTEX, partInfo.vertexCount, 1, uvn[m] );
+	}
+	// smooting group and material id
+	upload.setInt( "max_sg", HAPI_ATTROWNER_PRIM, numFaces, 1, sg );
+	upload.setInt( "max_mid", HAPI_ATTROWNER_PRIM, numFaces, 1, mid );
 
+	bool committed = upload.commit();
 	if (needDel) delete msh;
 
+	// an attribute of the last commit is gone, the geo is sent again from scratch
+	if ( !committed )
+		return InputMesh( asset_id, input_id, node, t, baseTM, scale, iasset, bakeTransform );
+	HAPI_ConnectAssetGeometry(hapi::Engine::instance()->session(), asset, 0, asset_id, input_id);
+
 	return asset;
 }
 
-HAPI_AssetId InputPoly( int asset_id, int input_id, INode* node, TimeValue t, Matrix3 &baseTM, double scale, InputAsset* iasset = NULL )
+HAPI_AssetId InputPoly( int asset_id, int input_id, INode* node, TimeValue t, Matrix3 &baseTM, double scale, InputAsset* iasset = NULL, bool bakeTransform = false )
 {
 	HAPI_AssetId asset;
 
@@ -231,6 +342,8 @@ HAPI_AssetId InputPoly( int asset_id, int input_id, INode* node, TimeValue t, Ma
 	else
 	{
 		HAPI_CreateInputAsset(hapi::Engine::instance()->session(), &asset, NULL);
+		if ( iasset )
+			iasset->resetUpload();
 	}
 
 	Object *pobj = node->EvalWorldState(t).obj;
@@ -238,7 +351,7 @@ HAPI_AssetId InputPoly( int asset_id, int input_id, INode* node, TimeValue t, Ma
 	MNMesh &msh = poly->GetMesh();
 
 	Matrix3 objectTM = node->GetObjectTM(t);
-	Matrix3 toLocalSpace = objectTM * Inverse(baseTM);
+	Matrix3 toLocalSpace = SetInputTransform( asset, iasset, objectTM * Inverse(baseTM), (float)scale, bakeTransform );
 	Matrix3 toLocalSpaceR = toLocalSpace;
 	toLocalSpaceR.SetTrans(Point3());
 
@@ -250,332 +363,270 @@ HAPI_AssetId InputPoly( int asset_id, int input_id, INode* node, TimeValue t, Ma
     partInfo.vertexCount      = 0;
     partInfo.pointCount       = msh.numv;
 
-	// compute vertices
+	// first vertex of every face
+	std::vector<int> vertexStart( msh.numf + 1 );
+	vertexStart[0] = 0;
 	for ( int i = 0; i < msh.numf; i++ )
+		vertexStart[i+1] = vertexStart[i] + msh.f[i].deg;
+	partInfo.vertexCount = vertexStart[msh.numf];
+
+	// normals, specified on demand
+	MNNormalSpec* nrmspec = msh.GetSpecifiedNormals();
+	if (!nrmspec)
 	{
-		partInfo.vertexCount += msh.f[i].deg;
+		msh.SpecifyNormals();
+		nrmspec = msh.GetSpecifiedNormals();
+		if (nrmspec)
+			nrmspec->CheckNormals();
 	}
-    // copy data to arrays
-	{
-		std::vector<int> vl;
-		std::vector<int> fc;
-		std::vector<float> pt;
-
-		vl.reserve( partInfo.vertexCount );
-		fc.reserve( partInfo.faceCount );
-		pt.reserve( partInfo.pointCount*3 );
+	if (nrmspec && nrmspec->GetNumFaces() != msh.numf)
+		nrmspec = NULL;
 
-		// convert unit scaling
-		float scl = (float)scale;
-		// build vertex and face count
-		for ( int i = 0; i < msh.numf; i++ )
-		{
-			fc.push_back( msh.f[i].deg );
-			for ( int j = msh.f[i].deg-1; j >= 0; --j )
-			{
-				vl.push_back( msh.f[i].vtx[j] );
-			}
-		}
-		for ( int i = 0; i < msh.numv; i++ )
+	// map channels that are sent, uv range 1 to (MAX_MESHMAPS-1)
+	std::vector<int> maps;
+	std::vector<MNMap*> mapData;
+	for (int i = 1; i < MAX_MESHMAPS; ++i)
+	{
+		MNMap* uv = msh.M(i);
+		if (uv && uv->numv && msh.numf == uv->numf)
 		{
-			Point3 p = msh.v[i].p * toLocalSpace;
-			float y = p.y;
-			p.y = p.z;
-			p.z = -y;
-			p *= scl;
-
-			pt.push_back( p.x );
-			pt.push_back( p.y );
-			pt.push_back( p.z );
+			maps.push_back(i);
+			mapData.push_back(uv);
 		}
-		// Set the data
-		HAPI_SetPartInfo(hapi::Engine::instance()->session(), asset, 0, 0, &partInfo);
-		HAPI_SetFaceCounts(hapi::Engine::instance()->session(), asset, 0, 0, &fc.front(), 0, partInfo.faceCount);
-		HAPI_SetVertexList(hapi::Engine::instance()->session(), asset, 0, 0, &vl.front(), 0, partInfo.vertexCount);
-		// Set position attributes.
-		HAPI_AttributeInfo pos_attr_info;
-		pos_attr_info.exists    = true;
-		pos_attr_info.owner     = HAPI_ATTROWNER_POINT;
-		pos_attr_info.storage   = HAPI_STORAGETYPE_FLOAT;
-		pos_attr_info.count     = partInfo.pointCount;
-		pos_attr_info.tupleSize = 3;
-		HAPI_AddAttribute(hapi::Engine::instance()->session(), asset, 0, 0, "P", &pos_attr_info);
-		HAPI_SetAttributeFloatData(hapi::Engine::instance()->session(), asset, 0, 0, "P", &pos_attr_info, &pt.front(), 0, partInfo.pointCount);
-	}
-	// normals
-    {
-		MNNormalSpec* nrmspec = 0;
-		nrmspec = msh.GetSpecifiedNormals();
-		if (!nrmspec)
-		{
-			msh.SpecifyNormals();
-			nrmspec = msh.GetSpecifiedNormals();
-			if (nrmspec)
-				nrmspec->CheckNormals();
+	}
 
+	// every array is sized up front and filled over face ranges on worker threads,
+	// only the HAPI calls stay on this thread
+	std::vector<int> fc( msh.numf );
+	std::vector<int> vl( partInfo.vertexCount );
+	std::vector<float> pt( partInfo.pointCount*3 );
+	std::vector<float> vertexNormals( nrmspec ? partInfo.vertexCount*3 : 0 );
+	std::vector<int> sg( msh.numf );
+	std::vector<int> mid( msh.numf );
+	std::vector< std::vector<float> > uvv( maps.size() );
+	std::vector< std::vector<int> > uvn( maps.size() );
+	for ( size_t m = 0; m < maps.size(); ++m )
+	{
+		uvv[m].resize( partInfo.vertexCount*3 );
+		uvn[m].resize( partInfo.vertexCount );
+	}
+
+	util::Affine34 nm;
+	util::GetHoudiniTransform( toLocalSpaceR, 1.f, nm );
+	util::ParallelForRanges( msh.numf, packChunk, [&]( int begin, int end )
+	{
+		for ( int i = begin; i < end; ++i )
+		{
+			const MNFace& face = msh.f[i];
+			int* corner = vl.data() + vertexStart[i];
+			fc[i] = face.deg;
+			for ( int j = 0; j < face.deg; ++j )
+				corner[j] = face.vtx[face.deg-1-j];
+			sg[i] = (int)face.smGroup;
+			mid[i] = (int)face.material;
 		}
-		if (nrmspec && nrmspec->GetNumFaces() == msh.numf)
+		if ( nrmspec )
 		{
-			// build the per-vertex normals
-			std::vector<float> vertexNormals;
-			vertexNormals.reserve(partInfo.vertexCount * 3);
-
-			for ( int f = 0; f < msh.numf; f++ )
+			for ( int i = begin; i < end; ++i )
 			{
-				MNNormalFace& nf = nrmspec->Face(f);
-				int deg = nf.GetDegree();
-
-				for(int i = deg-1; i >= 0; i--)
+				MNNormalFace& nf = nrmspec->Face(i);
+				int deg = msh.f[i].deg;
+				float* n = vertexNormals.data() + vertexStart[i]*3;
+				for ( int j = 0; j < deg; ++j )
 				{
-					Point3 n;
-
-					MNNormalFace& nf = nrmspec->Face(f);
-					n = nrmspec->Normal(nf.GetNormalID(i)) * toLocalSpaceR;
-					vertexNormals.push_back(n.x);
-					vertexNormals.push_back(n.z);
-					vertexNormals.push_back(-n.y);
+					const Point3& v = nrmspec->Normal(nf.GetNormalID(deg-1-j));
+					n[j*3+0] = v.x;
+					n[j*3+1] = v.y;
+					n[j*3+2] = v.z;
 				}
 			}
-			// add and set it to HAPI
-			HAPI_AttributeInfo attributeInfo;
-			attributeInfo.exists    = true;
-			attributeInfo.owner     = HAPI_ATTROWNER_VERTEX;
-			attributeInfo.storage   = HAPI_STORAGETYPE_FLOAT;
-			attributeInfo.count     = partInfo.vertexCount;
-			attributeInfo.tupleSize = 3;
-			HAPI_AddAttribute(hapi::Engine::instance()->session(), asset, 0, 0, "N", &attributeInfo);
-			HAPI_SetAttributeFloatData(hapi::Engine::instance()->session(), asset, 0, 0, "N", &attributeInfo,
-					&vertexNormals.front(), 0, partInfo.vertexCount);
+			int first = vertexStart[begin];
+			util::TransformPoints( vertexNormals.data() + first*3, vertexNormals.data() + first*3, vertexStart[end] - first, nm );
 		}
-    }
-	// uv
-	{
-		// uv range 1 to (MAX_MESHMAPS-1)
-		for (int i = 1; i < MAX_MESHMAPS; ++i)
+		for ( size_t m = 0; m < maps.size(); ++m )
 		{
-			MNMap* uv = msh.M(i);
-			if (uv && uv->numv && msh.numf == uv->numf)
+			const MNMap* uv = mapData[m];
+			for ( int i = begin; i < end; ++i )
 			{
-				std::string uvName;
-				std::string uvNumberName;
-				uvName = i == 1 ? std::string("uv") : std::string("uv") + std::to_string(i);
-				uvNumberName = i == 1 ? std::string("uvNumber") : std::string("uvNumber") + std::to_string(i);
-
-				std::vector<int> uvn;
-				std::vector<float> uvv;
-
-				for (int f = 0; f < uv->numf; ++f)
+				int deg = msh.f[i].deg;
+				float* uvp = uvv[m].data() + vertexStart[i]*3;
+				int* uvnp = uvn[m].data() + vertexStart[i];
+				for ( int j = 0; j < deg; ++j )
 				{
-					for (int deg = msh.f[i].deg - 1; deg >= 0; --deg)
-					{
-						int vv = uv->f[f].tv[deg];
-						uvv.push_back(uv->v[vv].x);
-						uvv.push_back(uv->v[vv].y);
-						uvv.push_back(0.0f);
-						uvn.push_back(vv);
-					}
-				}
-
-				if (partInfo.vertexCount == uvn.size())
-				{
-					// add and set it to HAPI
-					HAPI_AttributeInfo attributeInfo;
-					attributeInfo.exists = true;
-					attributeInfo.owner = HAPI_ATTROWNER_VERTEX;
-					attributeInfo.storage = HAPI_STORAGETYPE_FLOAT;
-					attributeInfo.count = partInfo.vertexCount;
-					attributeInfo.tupleSize = 3;
-					HAPI_AddAttribute(hapi::Engine::instance()->session(), asset, 0, 0, uvName.c_str(), &attributeInfo);
-					HAPI_SetAttributeFloatData(hapi::Engine::instance()->session(), asset, 0, 0, uvName.c_str(), &attributeInfo,
-						&uvv.front(), 0, partInfo.vertexCount);
-
-					attributeInfo.storage = HAPI_STORAGETYPE_INT;
-					attributeInfo.count = partInfo.vertexCount;
-					attributeInfo.tupleSize = 1;
-					HAPI_AddAttribute(hapi::Engine::instance()->session(), asset, 0, 0, uvNumberName.c_str(), &attributeInfo);
-					HAPI_SetAttributeIntData(hapi::Engine::instance()->session(), asset, 0, 0, uvNumberName.c_str(), &attributeInfo,
-						&uvn.front(), 0, partInfo.vertexCount);
+					int vv = uv->f[i].tv[deg-1-j];
+					uvp[j*3+0] = uv->v[vv].x;
+					uvp[j*3+1] = uv->v[vv].y;
+					uvp[j*3+2] = 0.0f;
+					uvnp[j] = vv;
 				}
 			}
 		}
+	} );
+
+	if ( msh.numv )
+	{
+		// convert unit scaling
+		util::Affine34 m;
+		util::GetHoudiniTransform( toLocalSpace, (float)scale, m );
+		util::ParallelForRanges( msh.numv, packChunk, [&]( int begin, int end )
+		{
+			util::TransformPoints( &msh.v[begin].p.x, &pt[begin*3], end - begin, m, sizeof(MNVert) );
+		} );
 	}
 
-	// smooting group and material id
+	GeoUpload upload( asset, iasset );
+	// Set the data, the topology only if it changed since the last commit
+	upload.setTopology( partInfo, fc, vl );
+	upload.setFloat( "P", HAPI_ATTROWNER_POINT, partInfo.pointCount, 3, pt );
+	if ( nrmspec )
+		upload.setFloat( "N", HAPI_ATTROWNER_VERTEX, partInfo.vertexCount, 3, vertexNormals );
+	for ( size_t m = 0; m < maps.size(); ++m )
 	{
-		std::vector<int>	sg;
-		std::vector<int>	mid;
-		sg.reserve( partInfo.faceCount );
-		mid.reserve( partInfo.faceCount );
+		int i = maps[m];
+		std::string uvName = i == 1 ? std::string("uv") : std::string("uv") + std::to_string(i);
+		std::string uvNumberName = i == 1 ? std::string("uvNumber") : std::string("uvNumber") + std::to_string(i);
+		upload.setFloat( uvName.c_str(), HAPI_ATTROWNER_VERTEX, partInfo.vertexCount, 3, uvv[m] );
+		upload.setInt( uvNumberName.c_str(), HAPI_ATTROWNER_VERTEX, partInfo.vertexCount, 1, uvn[m] );
+	}
+	// smooting group and material id
+	upload.setInt( "max_sg", HAPI_ATTROWNER_PRIM, msh.numf, 1, sg );
+	upload.setInt( "max_mid", HAPI_ATTROWNER_PRIM, msh.numf, 1, mid );
 
-		for ( int i = 0; i < msh.numf; ++i )
-		{
-			sg.push_back( (int)msh.f[i].smGroup );
-			mid.push_back( (int)msh.f[i].material );
-        }
-        HAPI_AttributeInfo attributeInfo;
-        attributeInfo.exists    = true;
-        attributeInfo.owner     = HAPI_ATTROWNER_PRIM;
-        attributeInfo.storage   = HAPI_STORAGETYPE_INT;
-        attributeInfo.count     = msh.numf;
-        attributeInfo.tupleSize = 1;
-		HAPI_AddAttribute(hapi::Engine::instance()->session(), asset, 0, 0, "max_sg", &attributeInfo);
-		HAPI_SetAttributeIntData(hapi::Engine::instance()->session(), asset, 0, 0, "max_sg", &attributeInfo,
-                &sg.front(), 0, msh.numf);
-        attributeInfo.exists    = true;
-        attributeInfo.owner     = HAPI_ATTROWNER_PRIM;
-        attributeInfo.storage   = HAPI_STORAGETYPE_INT;
-        attributeInfo.count     = msh.numf;
-        attributeInfo.tupleSize = 1;
-		HAPI_AddAttribute(hapi::Engine::instance()->session(), asset, 0, 0, "max_mid", &attributeInfo);
-		HAPI_SetAttributeIntData(hapi::Engine::instance()->session(), asset, 0, 0, "max_mid", &attributeInfo,
-                &mid.front(), 0, msh.numf);
-	}
-
-	HAPI_CommitGeo(hapi::Engine::instance()->session(), asset, 0, 0);
+	// an attribute of the last commit is gone, the geo is sent again from scratch
+	if ( !upload.commit() )
+		return InputPoly( asset_id, input_id, node, t, baseTM, scale, iasset, bakeTransform );
 	HAPI_ConnectAssetGeometry(hapi::Engine::instance()->session(), asset, 0, asset_id, input_id);
 
 	return asset;
 }
 
-HAPI_AssetId InputCurve( int asset_id, int input_id, INode* node, TimeValue t, Matrix3 &baseTM, double scale,  InputAsset* iasset = NULL )
+HAPI_AssetId InputCurve( int asset_id, int input_id, INode* node, TimeValue t, Matrix3 &baseTM, double scale, InputAsset* iasset = NULL, bool bakeTransform = false )
 {
-	HAPI_AssetId asset = -1;
+	HAPI_AssetId asset;
+
+	if ( iasset && iasset->node && iasset->asset_id >= 0 )
+	{
+		// Update
+		asset = iasset->asset_id;
+	}
+	else
+	{
+		HAPI_CreateInputAsset(hapi::Engine::instance()->session(), &asset, NULL);
+		if ( iasset )
+			iasset->resetUpload();
+	}
 
 	Object *pobj = node->EvalWorldState(t).obj;
 	ShapeObject *so = (ShapeObject *)pobj;
+	BezierShape shape;
+	if(so->CanMakeBezier())
+		so->MakeBezier(t, shape);
+	else
 	{
-		BezierShape shape;
-		Matrix3 objectTM = node->GetObjectTM(t);
-		Matrix3 toLocalSpace = objectTM * Inverse(baseTM);
-
-		if(so->CanMakeBezier()) 
-			so->MakeBezier(t, shape);
-		else
-		{
-			PolyShape pshape;
-			so->MakePolyShape(t, pshape);
-			shape = pshape;
-		}
-
-		HAPI_AssetInfo myCurveAssetInfo;
-		HAPI_NodeInfo myCurveNodeInfo;
+		PolyShape pshape;
+		so->MakePolyShape(t, pshape);
+		shape = pshape;
+	}
 
-		if ( iasset && iasset->node && iasset->asset_id >= 0 )
-		{
-			// Update
-			asset = iasset->asset_id;
-		}
-		else
-		{
-			// New
-			HAPI_CreateCurve(hapi::Engine::instance()->session(), &asset);
-		}
-		HAPI_GetAssetInfo(hapi::Engine::instance()->session(), asset, &myCurveAssetInfo);
-		HAPI_GetNodeInfo(hapi::Engine::instance()->session(), myCurveAssetInfo.nodeId, &myCurveNodeInfo);
-		HAPI_ConnectAssetGeometry(hapi::Engine::instance()->session(), asset, 0, asset_id, input_id);
-
-
-		// find coords parm
-		std::vector<HAPI_ParmInfo> parms(myCurveNodeInfo.parmCount);
-		HAPI_GetParameters(hapi::Engine::instance()->session(), myCurveNodeInfo.id, &parms[0], 0, myCurveNodeInfo.parmCount);
-		int typeParmIndex = util::FindParm(parms, "type");
-		int coordsParmIndex = util::FindParm(parms, "coords");
-		int orderParmIndex = util::FindParm(parms, "order");
-		int closeParmIndex = util::FindParm(parms, "close");
-		if(coordsParmIndex < 0
-			|| coordsParmIndex < 0
-			|| orderParmIndex < 0
-			|| closeParmIndex < 0)
+	Matrix3 objectTM = node->GetObjectTM(t);
+	Matrix3 toLocalSpace = SetInputTransform( asset, iasset, objectTM * Inverse(baseTM), (float)scale, bakeTransform );
+
+	// every spline is a cubic bezier curve: knot, out vector, in vector, knot ...
+	// a closed spline repeats its first knot at the end
+	std::vector<Spline3D*> splines;
+	std::vector<int> counts;
+	std::vector<int> cvStart( 1, 0 );
+	for ( int i = 0; i < shape.SplineCount(); ++i )
+	{
+		Spline3D* spline = shape.GetSpline(i);
+		int knots = spline->KnotCount();
+		if ( knots < 2 )
+			continue;
+		int segments = spline->Closed() ? knots : knots - 1;
+		splines.push_back( spline );
+		counts.push_back( segments * 3 + 1 );
+		cvStart.push_back( cvStart.back() + counts.back() );
+	}
+	int numCurves = (int)splines.size();
+	int numCVs = cvStart.back();
+
+	// max_knot_type is the KTYPE_ of a knot and -1 for the vectors
+	std::vector<float> pt( numCVs * 3 );
+	std::vector<int> knotType( numCVs );
+	std::vector<int> closed( numCurves );
+	util::ParallelFor( numCurves, [&]( int c )
+	{
+		Spline3D* spline = splines[c];
+		int knots = spline->KnotCount();
+		float* p = pt.data() + cvStart[c] * 3;
+		int* kt = knotType.data() + cvStart[c];
+		auto add = [&]( const Point3& v, int type )
 		{
-			return -1;
-		}
-
-		const HAPI_ParmInfo &typeParm = parms[typeParmIndex];
-		const HAPI_ParmInfo &coordsParm = parms[coordsParmIndex];
-		const HAPI_ParmInfo &orderParm = parms[orderParmIndex];
-		const HAPI_ParmInfo &closeParm = parms[closeParmIndex];
-
-		// type
+			p[0] = v.x;
+			p[1] = v.y;
+			p[2] = v.z;
+			p += 3;
+			*kt++ = type;
+		};
+		for ( int k = 0; k < knots; ++k )
 		{
-			HAPI_ParmChoiceInfo* choices = new HAPI_ParmChoiceInfo[typeParm.choiceCount];
-			HAPI_GetParmChoiceLists(hapi::Engine::instance()->session(), myCurveNodeInfo.id, choices, typeParm.choiceIndex, typeParm.choiceCount);
-
-			int typeIdx = -1;
-			for(int i = 0; i < typeParm.choiceCount; i++)
+			add( spline->GetKnotPoint(k), spline->GetKnotType(k) );
+			if ( k + 1 < knots || spline->Closed() )
 			{
-				if( util::GetString(choices[i].valueSH) == "bezier")
-				{
-					typeIdx = i;
-					break;
-				}
+				int next = (k + 1) % knots;
+				add( spline->GetOutVec(k), -1 );
+				add( spline->GetInVec(next), -1 );
 			}
+		}
+		if ( spline->Closed() )
+			add( spline->GetKnotPoint(0), spline->GetKnotType(0) );
+		closed[c] = spline->Closed() ? 1 : 0;
+	} );
 
-			delete [] choices;
-
-			if(typeIdx < 0)
-			{
-				return -1;
-			}
+	if ( numCVs )
+	{
+		// convert unit scaling
+		util::Affine34 m;
+		util::GetHoudiniTransform( toLocalSpace, (float)scale, m );
+		util::ParallelForRanges( numCVs, packChunk, [&]( int begin, int end )
+		{
+			util::TransformPoints( &pt[begin*3], &pt[begin*3], end - begin, m );
+		} );
+	}
 
-			HAPI_SetParmIntValues(hapi::Engine::instance()->session(), myCurveNodeInfo.id, &typeIdx, typeParm.intValuesIndex, 1);
-			{
-				// convert unit scaling
-				float scl = (float)scale;
-				int polys = shape.SplineCount();
-				for(int poly = 0; poly < polys; ++poly) 
-				{
-					Spline3D *spline = shape.GetSpline(poly);
-					int knots = spline->KnotCount();
-					std::ostringstream coords;
-					for(int ix = 0; ix < knots; ++ix) 
-					{
-						Point3 p;
-						if ( ix > 0 )
-						{
-							p = spline->GetInVec(ix) * toLocalSpace;
-							float y = p.y;
-							p.y = p.z;
-							p.z = -y;
-							p *= scl;
-							coords << p.x << "," << p.y << "," << p.z << " ";
-						}
-						p = spline->GetKnotPoint(ix) * toLocalSpace;
-						float y = p.y;
-						p.y = p.z;
-						p.z = -y;
-						p *= scl;
-						coords << p.x << "," << p.y << "," << p.z << " ";
-						if ( ix < (knots-1) )
-						{
-							p = spline->GetOutVec(ix) * toLocalSpace;
-							float y = p.y;
-							p.y = p.z;
-							p.z = -y;
-							p *= scl;
-							coords << p.x << "," << p.y << "," << p.z << " ";
-						}
-					}
-					HAPI_SetParmStringValue(hapi::Engine::instance()->session(), myCurveNodeInfo.id, coords.str().c_str(), coordsParm.id, coordsParm.stringValuesIndex);
-					break;
-				}
-			}
-			// order
-			{
-				int order = 4;
-				HAPI_SetParmIntValues(hapi::Engine::instance()->session(), myCurveNodeInfo.id, &order, orderParm.intValuesIndex, 1);
-			}
+	// set up part info
+	HAPI_PartInfo partInfo;
+	HAPI_PartInfo_Init(&partInfo);
+	partInfo.id = 0;
+	partInfo.type             = HAPI_PARTTYPE_CURVE;
+	partInfo.faceCount        = numCurves;
+	partInfo.vertexCount      = numCVs;
+	partInfo.pointCount       = numCVs;
+
+	HAPI_CurveInfo curveInfo;
+	curveInfo.curveType   = HAPI_CURVETYPE_BEZIER;
+	curveInfo.curveCount  = numCurves;
+	curveInfo.vertexCount = numCVs;
+	curveInfo.knotCount   = 0;
+	curveInfo.isPeriodic  = false;
+	curveInfo.order       = 4;
+	curveInfo.hasKnots    = false;
+
+	GeoUpload upload( asset, iasset );
+	upload.setCurves( partInfo, curveInfo, counts );
+	upload.setFloat( "P", HAPI_ATTROWNER_POINT, numCVs, 3, pt );
+	upload.setInt( "max_knot_type", HAPI_ATTROWNER_POINT, numCVs, 1, knotType );
+	upload.setInt( "max_closed", HAPI_ATTROWNER_PRIM, numCurves, 1, closed );
+
+	// an attribute of the last commit is gone, the geo is sent again from scratch
+	if ( !upload.commit() )
+		return InputCurve( asset_id, input_id, node, t, baseTM, scale, iasset, bakeTransform );
+	HAPI_ConnectAssetGeometry(hapi::Engine::instance()->session(), asset, 0, asset_id, input_id);
 
-			// periodicity
-			{
-				int close = 0;
-				HAPI_SetParmIntValues(hapi::Engine::instance()->session(), myCurveNodeInfo.id, &close, closeParm.intValuesIndex, 1);
-			}
-		}
-	}
 	return asset;
 }
 
-HAPI_AssetId InputParticle(int asset_id, int input_id, INode* node, TimeValue t, Matrix3 &baseTM, double scale, InputAsset* iasset = NULL)
+HAPI_AssetId InputParticle(int asset_id, int input_id, INode* node, TimeValue t, Matrix3 &baseTM, double scale, InputAsset* iasset = NULL, bool bakeTransform = false)
 {
 	HAPI_AssetId asset;
 
@@ -587,13 +638,16 @@ HAPI_AssetId InputParticle(int asset_id, int input_id, INode* node, TimeValue t,
 	else
 	{
 		HAPI_CreateInputAsset(hapi::Engine::instance()->session(), &asset, NULL);
+		if (iasset)
+			iasset->resetUpload();
 	}
 
+	GeoUpload upload(asset, iasset);
 	// create particle
 	{
 		//get the nodes tm
 		//Matrix3 objectTM = node->GetObjectTM(t);
-		Matrix3 toLocalSpace = Inverse(baseTM);
+		Matrix3 toLocalSpace = SetInputTransform(asset, iasset, Inverse(baseTM), (float)scale, bakeTransform);
 		ObjectState tos = node->EvalWorldState(t, TRUE);
 
 		if (tos.obj->IsParticleSystem())
@@ -615,37 +669,16 @@ HAPI_AssetId InputParticle(int asset_id, int input_id, INode* node, TimeValue t,
 				partInfo.vertexCount = 0;
 				partInfo.pointCount = count;
 
-				std::vector<float>	pt;
-				
-				pt.reserve(count * 3);
+				std::vector<float>	pt(count * 3);
 
-				for (int pid = 0; pid < count; pid++)
+				if (count)
 				{
-					TimeValue age = pobj->ParticleAge(t, pid);
-					TimeValue life = pobj->ParticleLife(t, pid);
-					float psize = pobj->ParticleSize(t, pid);
-					Point3 p = pobj->parts.points[pid] * toLocalSpace;
-					Point3 v = pobj->ParticleVelocity(t, pid);
-
-					float y = p.y;
-					p.y = p.z;
-					p.z = -y;
-					p *= scale;
-
-					pt.push_back(p.x);
-					pt.push_back(p.y);
-					pt.push_back(p.z);
-
+					util::Affine34 m;
+					util::GetHoudiniTransform(toLocalSpace, (float)scale, m);
+					util::TransformPoints(&pobj->parts.points[0].x, &pt.front(), count, m);
 				}
-				HAPI_SetPartInfo(hapi::Engine::instance()->session(), asset, 0, 0, &partInfo);
-				HAPI_AttributeInfo pos_attr_info;
-				pos_attr_info.exists = true;
-				pos_attr_info.owner = HAPI_ATTROWNER_POINT;
-				pos_attr_info.storage = HAPI_STORAGETYPE_FLOAT;
-				pos_attr_info.count = count;
-				pos_attr_info.tupleSize = 3;
-				HAPI_AddAttribute(hapi::Engine::instance()->session(), asset, 0, 0, "P", &pos_attr_info);
-				HAPI_SetAttributeFloatData(hapi::Engine::instance()->session(), asset, 0, 0, "P", &pos_attr_info, &pt.front(), 0, count);
+				upload.setTopology(partInfo, std::vector<int>(), std::vector<int>());
+				upload.setFloat("P", HAPI_ATTROWNER_POINT, count, 3, pt);
 			}
 			else
 			{
@@ -664,43 +697,32 @@ HAPI_AssetId InputParticle(int asset_id, int input_id, INode* node, TimeValue t,
 					partInfo.vertexCount = 0;
 					partInfo.pointCount = count;
 
-					std::vector<float>	pt;
-
-					pt.reserve(count * 3);
+					std::vector<float>	pt(count * 3);
 
+					// positions are only reachable one by one, gather them and transform in place
 					for (int pid = 0; pid < count; pid++)
 					{
-						TimeValue age = epobj->GetParticleAgeByIndex(pid);
-						TimeValue life = epobj->GetParticleLifeSpanByIndex(pid);
-						Point3 p = *epobj->GetParticlePositionByIndex(pid) * toLocalSpace;
-						float psize = epobj->GetParticleScaleByIndex(pid);
-						Point3 v = *epobj->GetParticleSpeedByIndex(pid);
-
-						float y = p.y;
-						p.y = p.z;
-						p.z = -y;
-						p *= scale;
-
-						pt.push_back(p.x);
-						pt.push_back(p.y);
-						pt.push_back(p.z);
+						Point3 p = *epobj->GetParticlePositionByIndex(pid);
+						pt[pid * 3 + 0] = p.x;
+						pt[pid * 3 + 1] = p.y;
+						pt[pid * 3 + 2] = p.z;
+					}
+					if (count)
+					{
+						util::Affine34 m;
+						util::GetHoudiniTransform(toLocalSpace, (float)scale, m);
+						util::TransformPoints(&pt.front(), &pt.front(), count, m);
 					}
 
-					HAPI_SetPartInfo(hapi::Engine::instance()->session(), asset, 0, 0, &partInfo);
-					HAPI_AttributeInfo pos_attr_info;
-					pos_attr_info.exists = true;
-					pos_attr_info.owner = HAPI_ATTROWNER_POINT;
-					pos_attr_info.storage = HAPI_STORAGETYPE_FLOAT;
-					pos_attr_info.count = count;
-					pos_attr_info.tupleSize = 3;
-					HAPI_AddAttribute(hapi::Engine::instance()->session(), asset, 0, 0, "P", &pos_attr_info);
-					HAPI_SetAttributeFloatData(hapi::Engine::instance()->session(), asset, 0, 0, "P", &pos_attr_info, &pt.front(), 0, count);
+					upload.setTopology(partInfo, std::vector<int>(), std::vector<int>());
+					upload.setFloat("P", HAPI_ATTROWNER_POINT, count, 3, pt);
 				}
 			}
 		}
 	}
 
-	HAPI_CommitGeo(hapi::Engine::instance()->session(), asset, 0, 0);
+	if (!upload.commit())
+		return InputParticle(asset_id, input_id, node, t, baseTM, scale, iasset, bakeTransform);
 	HAPI_ConnectAssetGeometry(hapi::Engine::instance()->session(), asset, 0, asset_id, input_id);
 
 	return asset;
@@ -709,7 +731,7 @@ HAPI_AssetId InputParticle(int asset_id, int input_id, INode* node, TimeValue t,
 
 
 
-HAPI_AssetId InputNode( int asset_id, int input_id, INode* node, TimeValue t, Matrix3& baseTM, double scale, InputAsset* iasset)
+HAPI_AssetId InputNode( int asset_id, int input_id, INode* node, TimeValue t, Matrix3& baseTM, double scale, InputAsset* iasset, bool bakeTransform)
 {
 	HAPI_AssetId asset = -1;
 	HAPI_AssetInfo assetInfo;
@@ -722,20 +744,20 @@ HAPI_AssetId InputNode( int asset_id, int input_id, INode* node, TimeValue t, Ma
 		{
 			if (pobj->IsParticleSystem())
 			{
-				asset = InputParticle(assetInfo.id, input_id, node, t, baseTM, scale, iasset);
+				asset = InputParticle(assetInfo.id, input_id, node, t, baseTM, scale, iasset, bakeTransform);
 			}
 			else if (pobj->IsSubClassOf(polyObjectClassID))
 			{
-				asset = InputPoly( assetInfo.id, input_id, node, t, baseTM, scale, iasset );
+				asset = InputPoly( assetInfo.id, input_id, node, t, baseTM, scale, iasset, bakeTransform );
 			}
 			else
 			{
-				asset = InputMesh( assetInfo.id, input_id, node, t, baseTM, scale, iasset );
+				asset = InputMesh( assetInfo.id, input_id, node, t, baseTM, scale, iasset, bakeTransform );
 			}
 		}
 		else if ( pobj->SuperClassID() == SHAPE_CLASS_ID )                    
 		{
-			asset = InputCurve( assetInfo.id, input_id, node, t, baseTM, scale, iasset );
+			asset = InputCurve( assetInfo.id, input_id, node, t, baseTM, scale, iasset, bakeTransform );
 		}
 	}
 	return asset;
@@ -785,7 +807,7 @@ void InputAssets::setAssetId( int asset_id )
 	}
 }
 
-bool InputAssets::setNode( int ch, INode* node, TimeValue t, Matrix3 &baseTM, double scale, bool check_v_update )
+bool InputAssets::setNode( int ch, INode* node, TimeValue t, Matrix3 &baseTM, double scale, bool check_v_update, bool bake_transform )
 {
 	bool result = false;
 	if ( ch < inputs.size() )
@@ -797,7 +819,9 @@ bool InputAssets::setNode( int ch, INode* node, TimeValue t, Matrix3 &baseTM, do
 
 			if ( node )
 			{
-				HAPI_AssetId id = InputNode( assetInfo.id, ch, node, t, baseTM, scale );
+				// a new input asset, the hashes of this upload are kept for the next one
+				inputs[ch].asset_id = -1;
+				HAPI_AssetId id = InputNode( assetInfo.id, ch, node, t, baseTM, scale, &inputs[ch], bake_transform );
 				if ( id >= 0 )
 				{
 					inputs[ch].asset_id = id;
@@ -808,7 +832,7 @@ bool InputAssets::setNode( int ch, INode* node, TimeValue t, Matrix3 &baseTM, do
 		}
 		else if ( check_v_update && inputs[ch].node == node )
 		{
-			InputNode( assetInfo.id, ch, node, t, baseTM, scale, &inputs[ch] );
+			InputNode( assetInfo.id, ch, node, t, baseTM, scale, &inputs[ch], bake_transform );
 			result = true;
 		}
 	}
@@ -827,6 +851,7 @@ void InputAssets::disconnect( int ch, bool free_node )
 		{
 			HAPI_DestroyAsset(hapi::Engine::instance()->session(), inputs[ch].asset_id);
 			inputs[ch].asset_id = -1;
+			inputs[ch].resetUpload();
 		}
 	}
 }
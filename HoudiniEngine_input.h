@@ -2,16 +2,27 @@
 #define  __HOUDINI_ENGINE_INPUT__
 
 #include <vector>
+#include <map>
+#include <string>
+#include <stdint.h>
 
 class INode;
 struct InputAsset
 {
-	InputAsset() : node(nullptr), asset_id(-1) {}
+	InputAsset() : node(nullptr), asset_id(-1), topologyHash(0), transformHash(0) {}
 	INode*	node;
 	int		asset_id;
+
+	// hashes of the last commit, arrays that did not change are not sent again
+	uint64_t						topologyHash;		// point count, face counts and vertex list
+	std::map<std::string, uint64_t>	attributeHashes;	// by attribute name
+	uint64_t						transformHash;		// object transform of the input asset
+
+	void resetUpload() { topologyHash = 0; attributeHashes.clear(); transformHash = 0; }
 };
 
-int InputNode( int asset_id, int input_id, INode* node, TimeValue t, Matrix3 &baseTM, double scale, InputAsset* iasset = NULL);
+// bakeTransform moves the points into the space of the asset node instead of setting the object transform
+int InputNode( int asset_id, int input_id, INode* node, TimeValue t, Matrix3 &baseTM, double scale, InputAsset* iasset = NULL, bool bakeTransform = false );
 
 class InputAssets
 {
@@ -19,7 +30,7 @@ public:
 	InputAssets();
 	~InputAssets();
 	void setAssetId( int asset_id );
-	bool setNode( int ch, INode* node, TimeValue t, Matrix3 &baseTM, double scale, bool check_v_update = false );
+	bool setNode( int ch, INode* node, TimeValue t, Matrix3 &baseTM, double scale, bool check_v_update = false, bool bake_transform = false );
 	void disconnect( int ch, bool free_node = true );
 	void release();
 	int getAssetId() { return assetId;  }
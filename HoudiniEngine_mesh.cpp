@@ -3,6 +3,8 @@
 #include <custattrib.h>
 #include <maxscript/maxscript.h>
 #include "HoudiniEngine_mesh.h"
+#include "HoudiniEngine_object.h"
+#include <splshape.h>
 
 using namespace std;
 
@@ -37,7 +39,17 @@ enum {
 	pb_conv_unit_o,
 	pb_texture_path,
 	pb_auto_update,
-	pb_bypass
+	pb_bypass,
+	pb_deform_only,
+	pb_output_poly,
+	pb_display_mode,
+	pb_split_objects,
+	pb_bake_input_xform
+};
+enum {
+	display_full,
+	display_box,
+	display_points
 };
 
 static ParamBlockDesc2 houdiniengine_param_blk ( 
@@ -76,6 +88,26 @@ static ParamBlockDesc2 houdiniengine_param_blk (
 	p_default,			false,
 	p_ui,				ui_asset, TYPE_SINGLECHEKBOX, IDC_BYPASS,
 	p_end,
+	pb_deform_only,		_T("deformonly"), TYPE_BOOL, 0, IDS_HE_DEFORM_ONLY,
+	p_default,			false,
+	p_ui,				ui_asset, TYPE_SINGLECHEKBOX, IDC_DEFORM_ONLY,
+	p_end,
+	pb_output_poly,		_T("outputpoly"), TYPE_BOOL, 0, IDS_HE_OUTPUT_POLY,
+	p_default,			false,
+	p_ui,				ui_asset, TYPE_SINGLECHEKBOX, IDC_OUTPUT_POLY,
+	p_end,
+	pb_display_mode,	_T("displaymode"), TYPE_INT, 0, IDS_HE_DISPLAY_MODE,
+	p_default,			display_full,
+	p_ui,				ui_asset, TYPE_RADIO, 3, IDC_DISPLAY_FULL, IDC_DISPLAY_BOX, IDC_DISPLAY_POINTS,
+	p_end,
+	pb_split_objects,	_T("splitobjects"), TYPE_BOOL, 0, IDS_HE_SPLIT_OBJECTS,
+	p_default,			false,
+	p_ui,				ui_asset, TYPE_SINGLECHEKBOX, IDC_SPLIT_OBJECTS,
+	p_end,
+	pb_bake_input_xform,	_T("bakeinputtransforms"), TYPE_BOOL, 0, IDS_HE_BAKE_INPUT_XFORM,
+	p_default,			false,
+	p_ui,				ui_asset, TYPE_SINGLECHEKBOX, IDC_BAKE_INPUT_XFORM,
+	p_end,
 	p_end
 	);
 
@@ -160,6 +192,13 @@ HoudiniEngineMesh::HoudiniEngineMesh()
 	custAttributeUpdate	= false;
 	reCook				= false;
 	outScale			= 1.0;
+	outPolygons			= false;
+	outDisplayMode		= display_full;
+	proxyMesh			= false;
+	renderForce			= true;
+	outSplit			= false;
+	forceGeneration		= 0;
+	faceGroupsDirty		= false;
 	hProgress			= 0;
 	//pblock2 = NULL;
 	GetHoudiniEngineMeshDesc()->MakeAutoParamBlocks(this);
@@ -229,17 +268,27 @@ void HoudiniEngineMesh::BuildMesh(TimeValue t)
 	bool conv_unit_o = pblock2->GetInt(pb_conv_unit_o) != 0;
 	bool time_update = pblock2->GetInt(pb_updatetime, t) ? true : false;
 	bool bypass	     = pblock2->GetInt(pb_bypass, t) ? true : false;
+	bool deform_only = pblock2->GetInt(pb_deform_only, t) ? true : false;
+	bool output_poly = pblock2->GetInt(pb_output_poly, t) ? true : false;
+	int display_mode = pblock2->GetInt(pb_display_mode, t);
+	bool split_objects = pblock2->GetInt(pb_split_objects, t) ? true : false;
 
 	if (bypass)
 		reCook = true;
 
 	hapi::Engine* engine = hapi::Engine::instance();
 	buildingMesh = true;
+	proxyMesh = false;
 
 	if (!engine || !engine->isInitialize() || bypass)
 	{
 		util::BuildLogoMesh(mesh);
 		mesh.InvalidateTopologyCache();
+		polyMesh.ClearAndFree();
+		particles.clear();
+		objectStates.clear();
+		faceGroups.clear();
+		faceGroupsDirty = false;
 		buildingMesh  = false;
 		return;
 	}
@@ -328,8 +377,40 @@ void HoudiniEngineMesh::BuildMesh(TimeValue t)
 		{
 			int verts = mesh.getNumVerts();
 			double scl = conv_unit_o ? GetRelativeScale( UNITS_METERS, 1, GetUSDefaultUnit(), 1 ) : 1.0;
-			util::BuildMeshFromCookResult( mesh, assetId, (float)scl, new_loading || (scl != outScale) || reCook );
+			bool force = new_loading || (scl != outScale) || (output_poly != outPolygons) || (display_mode != outDisplayMode) || (split_objects != outSplit) || reCook;
+			if ( split_objects )
+			{
+				// the object nodes show the geometry, this one only keeps the logo
+				UpdateObjectStates( (float)scl, force );
+				polyMesh.ClearAndFree();
+				proxyCache.clear();
+				mesh.FreeAll();
+			}
+			else if ( display_mode != display_full )
+			{
+				// the viewport only gets a proxy, the full mesh is built in GetRenderMesh
+				polyMesh.ClearAndFree();
+				util::BuildProxyFromCookResult( mesh, proxyCache, assetId, (float)scl, force, display_mode == display_points ? PROXY_POINTS_MAX : 0 );
+				proxyMesh = true;
+				renderForce = renderForce || force;
+			}
+			else
+			{
+				if ( !output_poly )
+					polyMesh.ClearAndFree();
+				proxyCache.clear();
+				if ( util::BuildMeshFromCookResult( mesh, geomCache, assetId, (float)scl, force, deform_only, output_poly ? &polyMesh : NULL ) )
+					faceGroupsDirty = true;
+				renderMesh.FreeAll();
+				renderForce = true;
+			}
+			util::BuildParticlesFromCookResult( particles, assetId, (float)scl, force );
 			outScale = (float)scl;
+			outPolygons = output_poly;
+			outDisplayMode = display_mode;
+			outSplit = split_objects;
+			if ( !split_objects )
+				objectStates.clear();
 			if (mesh.getNumVerts() && verts != mesh.getNumVerts())
 			{
 				mesh.InvalidateTopologyCache();
@@ -338,8 +419,10 @@ void HoudiniEngineMesh::BuildMesh(TimeValue t)
 	}
 	if ( !mesh.getNumVerts() )
 	{
+		proxyMesh = false;
 		util::BuildLogoMesh( mesh);
 		mesh.InvalidateTopologyCache();
+		polyMesh.ClearAndFree();
 	}
 	ivalid.Set(t,t);
 	buildingMesh = false;
@@ -488,7 +571,8 @@ bool HoudiniEngineMesh::SetInputNode(int ch, INode* node)
 
 		bool conv_unit_i = pblock2->GetInt(pb_conv_unit_i) != 0;
 		double scl = conv_unit_i ? GetRelativeScale(GetUSDefaultUnit(), 1, UNITS_METERS, 1) : 1.0;
-		inputs.setNode(ch, node, t, baseTM, scl, needUpdateInputNode );
+		bool bake_xform = pblock2->GetInt(pb_bake_input_xform) != 0;
+		inputs.setNode(ch, node, t, baseTM, scl, needUpdateInputNode, bake_xform );
 		result = true;
 #if defined(USE_NOTIFYREFCHANGED)
 		if (node->TestForLoop(FOREVER, this) == REF_SUCCEED) {
@@ -532,6 +616,262 @@ bool HoudiniEngineMesh::CreateMaterial()
 	return result;
 }
 
+// child nodes created by CreateInstances / CreateSplines carry these user properties
+#define HE_INSTANCE_PROP	_T("HoudiniEngineInstance")
+#define HE_SPLINE_PROP		_T("HoudiniEngineSpline")
+
+// delete the child nodes an earlier call created
+static void DeleteOutputNodes(INode* node, const MCHAR* prop)
+{
+	for ( int i = node->NumberOfChildren() - 1; i >= 0; --i )
+	{
+		INode* child = node->GetChildNode(i);
+		BOOL output = FALSE;
+		if ( child->GetUserPropBool(prop, output) && output )
+			GetCOREInterface()->DeleteNode(child, FALSE);
+	}
+}
+
+bool HoudiniEngineMesh::CreateInstances()
+{
+	bool result = false;
+
+	if ( assetId >= 0 )
+	{
+		INode* node = GetINode();
+		if ( node )
+		{
+			Interface* core = GetCOREInterface();
+			TimeValue t = core->GetTime();
+			std::vector<util::Instancer> instancers;
+			util::GetInstancers( assetId, outScale, instancers );
+
+			theHold.Begin();
+			core->DisableSceneRedraw();
+
+			// replace the instances of an earlier call
+			DeleteOutputNodes(node, HE_INSTANCE_PROP);
+
+			// every instance node references the one mesh of its instanced object
+			Matrix3 baseTM = node->GetObjectTM(t);
+			std::map<HAPI_ObjectId, TriObject*> meshes;
+			for ( size_t i = 0; i < instancers.size(); ++i )
+			{
+				const util::Instancer& instancer = instancers[i];
+				TriObject*& tri = meshes[instancer.source];
+				if ( !tri )
+				{
+					tri = CreateNewTriObject();
+					util::BuildObjectMesh( tri->GetMesh(), assetId, instancer.source, outScale );
+				}
+
+				TSTR baseName = TSTR::FromUTF8(instancer.name.c_str());
+				for ( size_t n = 0; n < instancer.transforms.size(); ++n )
+				{
+					INode* child = core->CreateObjectNode(tri);
+					TSTR name;
+					name.printf(_T("%s_%d"), baseName.data(), (int)n);
+					child->SetName(name);
+					node->AttachChild(child, FALSE);
+					Matrix3 tm = instancer.transforms[n] * baseTM;
+					child->SetNodeTM(t, tm);
+					child->SetMtl(node->GetMtl());
+					child->SetUserPropBool(HE_INSTANCE_PROP, TRUE);
+				}
+			}
+
+			core->EnableSceneRedraw();
+			theHold.Accept(GetString(IDS_HE_CREATE_INSTANCES));
+			result = true;
+		}
+	}
+	return result;
+}
+
+bool HoudiniEngineMesh::CreateSplines()
+{
+	bool result = false;
+
+	if ( assetId >= 0 )
+	{
+		INode* node = GetINode();
+		if ( node )
+		{
+			Interface* core = GetCOREInterface();
+			TimeValue t = core->GetTime();
+			SplineShape* shape = (SplineShape*)CreateInstance(SHAPE_CLASS_ID, splineShapeClassID);
+			util::BuildShapeFromCookResult( shape->shape, assetId, outScale );
+
+			theHold.Begin();
+			DeleteOutputNodes(node, HE_SPLINE_PROP);
+			if ( shape->shape.splineCount )
+			{
+				INode* child = core->CreateObjectNode(shape);
+				child->SetName(node->GetName());
+				node->AttachChild(child, FALSE);
+				Matrix3 tm = node->GetObjectTM(t);
+				child->SetNodeTM(t, tm);
+				child->SetUserPropBool(HE_SPLINE_PROP, TRUE);
+				result = true;
+			}
+			else
+				shape->DeleteThis();
+			theHold.Accept(GetString(IDS_HE_CREATE_SPLINES));
+		}
+	}
+	return result;
+}
+
+#define HE_OBJECT_PROP		_T("HoudiniEngineObject")
+
+bool HoudiniEngineMesh::CreateObjectNodes()
+{
+	bool result = false;
+
+	if ( assetId >= 0 )
+	{
+		INode* node = GetINode();
+		if ( node )
+		{
+			Interface* core = GetCOREInterface();
+			TimeValue t = core->GetTime();
+
+			theHold.Begin();
+			core->DisableSceneRedraw();
+
+			// the object states are only kept in split mode
+			pblock2->SetValue(pb_split_objects, t, TRUE);
+			UpdateMesh(t);
+
+			// replace the object nodes of an earlier call
+			DeleteOutputNodes(node, HE_OBJECT_PROP);
+
+			// the node sits where the object was at creation, HoudiniEngineObject moves it by later changes
+			Matrix3 baseTM = node->GetObjectTM(t);
+			for ( std::map<std::string, HoudiniEngineObjectState>::const_iterator it = objectStates.begin(); it != objectStates.end(); ++it )
+			{
+				HoudiniEngineObject* obj = (HoudiniEngineObject*)CreateInstance(GEOMOBJECT_CLASS_ID, HOUDINIENGINE_OBJECT_CLASS_ID);
+				obj->SetSource(this, it->first, it->second.transform);
+
+				INode* child = core->CreateObjectNode(obj);
+				child->SetName(TSTR::FromUTF8(it->second.name.c_str()));
+				node->AttachChild(child, FALSE);
+				Matrix3 tm = it->second.transform * baseTM;
+				child->SetNodeTM(t, tm);
+				child->SetMtl(node->GetMtl());
+				child->SetUserPropBool(HE_OBJECT_PROP, TRUE);
+			}
+
+			core->EnableSceneRedraw();
+			theHold.Accept(GetString(IDS_HE_CREATE_OBJECTS));
+			result = true;
+		}
+	}
+	return result;
+}
+
+// scenes saved before the states were keyed by path stored the display name, that is matched
+// when exactly one object has it
+const HoudiniEngineObjectState* HoudiniEngineMesh::FindObjectState(const std::string& path) const
+{
+	std::map<std::string, HoudiniEngineObjectState>::const_iterator it = objectStates.find(path);
+	if ( it != objectStates.end() )
+		return &it->second;
+
+	const HoudiniEngineObjectState* found = NULL;
+	for ( it = objectStates.begin(); it != objectStates.end(); ++it )
+	{
+		if ( it->second.name != path )
+			continue;
+		if ( found )
+			return NULL;
+		found = &it->second;
+	}
+	return found;
+}
+
+bool HoudiniEngineMesh::DeformOnly(TimeValue t)
+{
+	return pblock2->GetInt(pb_deform_only, t) ? true : false;
+}
+
+// a cook only depends on t when the asset follows the time slider or a parameter is animated.
+// the hda parameters are the custom attributes of the node, see UpdateParameters.
+// input nodes are polled on every evaluation, so any connected input makes it [t,t] as well
+Interval HoudiniEngineMesh::CookValidity(TimeValue t)
+{
+	Interval iv = FOREVER;
+	pblock2->GetValidity(t, iv);
+	if ( pblock2->GetInt(pb_updatetime, t) )
+		iv.Set(t,t);
+	for ( size_t i = 0; i < inputs.getNumInputs(); ++i )
+	{
+		if ( inputs.getINode((int)i) )
+			iv.Set(t,t);
+	}
+
+	INode* node = GetINode();
+	if ( node )
+	{
+		for ( int i = 0; i < node->NumSubs(); ++i )
+		{
+			Animatable* anim = node->SubAnim(i);
+			if ( !anim )
+				continue;
+			for ( int block = 0; block < anim->NumParamBlocks(); ++block )
+			{
+				IParamBlock2* pblock = anim->GetParamBlock(block);
+				if ( !pblock )
+					continue;
+				pblock->GetValidity(t, iv);
+				for ( int p = 0; p < pblock->NumParams(); ++p )
+				{
+					ParamID id = pblock->IndextoID(p);
+					std::string hname = CStr::FromMSTR(pblock->GetLocalName(id)).data();
+					if ( hname.compare(0, 10, "__he_input") == 0 && pblock->GetINode(id, t) )
+						iv.Set(t,t);
+				}
+			}
+		}
+	}
+	return iv;
+}
+
+// keeps the states of the previous cook and bumps the generations of every object that changed since
+void HoudiniEngineMesh::UpdateObjectStates(float scl, bool force)
+{
+	if ( force )
+		forceGeneration++;
+
+	std::vector<util::OutputObject> objects;
+	util::GetOutputObjects( assetId, scl, objects );
+
+	std::map<std::string, HoudiniEngineObjectState> states;
+	for ( size_t i = 0; i < objects.size(); ++i )
+	{
+		const util::OutputObject& object = objects[i];
+		HoudiniEngineObjectState& state = states[object.path];
+		std::map<std::string, HoudiniEngineObjectState>::const_iterator last = objectStates.find(object.path);
+		if ( last != objectStates.end() )
+		{
+			state = last->second;
+		}
+		else
+		{
+			state.geoGeneration = 0;
+			state.xformGeneration = 0;
+		}
+		state.id = object.id;
+		state.name = object.name;
+		if ( object.geosChanged )
+			state.geoGeneration++;
+		if ( object.transformChanged || !(state.transform == object.transform) )
+			state.xformGeneration++;
+		state.transform = object.transform;
+	}
+	objectStates.swap(states);
+}
+
 BOOL HoudiniEngineMesh::OKtoDisplay(TimeValue t) 
 {
 	return TRUE;
@@ -542,6 +882,126 @@ void HoudiniEngineMesh::InvalidateUI()
 	houdiniengine_param_blk.InvalidateUI();
 }
 
+int HoudiniEngineMesh::CanConvertToType(Class_ID obtype)
+{
+	if ( obtype == polyObjectClassID )
+		return TRUE;
+	return SimpleObject2::CanConvertToType(obtype);
+}
+
+Object* HoudiniEngineMesh::ConvertToType(TimeValue t, Class_ID obtype)
+{
+	// hand out the cooked polygons as they are instead of going through the tri mesh
+	if ( obtype == polyObjectClassID )
+	{
+		UpdateMesh(t);
+		if ( outPolygons && polyMesh.numf )
+		{
+			PolyObject* pobj = CreateEditablePolyObject();
+			pobj->mm = polyMesh;
+			pobj->SetChannelValidity(TOPO_CHAN_NUM, ObjectValidity(t));
+			pobj->SetChannelValidity(GEOM_CHAN_NUM, ObjectValidity(t));
+			pobj->SetChannelValidity(TEXMAP_CHAN_NUM, ObjectValidity(t));
+			return pobj;
+		}
+	}
+	return SimpleObject2::ConvertToType(t, obtype);
+}
+
+Mesh* HoudiniEngineMesh::GetRenderMesh(TimeValue t, INode *inode, View& view, BOOL& needDelete)
+{
+	UpdateMesh(t);
+	needDelete = FALSE;
+
+	// the object nodes render the geometry, the logo is only for the viewport
+	if ( outSplit )
+	{
+		renderMesh.FreeAll();
+		return &renderMesh;
+	}
+	if ( !proxyMesh )
+		return &mesh;
+
+	BuildRenderMesh(t);
+	return renderMesh.getNumVerts() ? &renderMesh : &mesh;
+}
+
+// the asset was cooked for t by UpdateMesh, only the conversion is left
+void HoudiniEngineMesh::BuildRenderMesh(TimeValue t)
+{
+	bool deform_only = pblock2->GetInt(pb_deform_only, t) ? true : false;
+	if ( util::BuildMeshFromCookResult( renderMesh, geomCache, assetId, outScale, renderForce, deform_only ) )
+		faceGroupsDirty = true;
+	renderForce = false;
+}
+
+const std::vector<util::FaceGroup>& HoudiniEngineMesh::GetFaceGroups(TimeValue t)
+{
+	UpdateMesh(t);
+	if ( outSplit )
+	{
+		faceGroups.clear();
+		return faceGroups;
+	}
+
+	// with a proxy in the viewport the groups refer to the render mesh
+	if ( proxyMesh )
+		BuildRenderMesh(t);
+	if ( faceGroupsDirty )
+	{
+		int numFaces = proxyMesh ? renderMesh.getNumFaces() : mesh.getNumFaces();
+		util::GetFaceGroups( geomCache, numFaces, faceGroups );
+		faceGroupsDirty = false;
+	}
+	return faceGroups;
+}
+
+BaseInterface* HoudiniEngineMesh::GetInterface(Interface_ID id)
+{
+	if ( id == PARTICLEOBJECTEXT_INTERFACE )
+		return (IParticleObjectExt*)this;
+	return SimpleObject2::GetInterface(id);
+}
+
+// max handles a particle system as particles only, an asset that also has faces would lose its mesh.
+// its points are still handed out through IParticleObjectExt
+BOOL HoudiniEngineMesh::IsParticleSystem()
+{
+	if ( !particles.count() )
+		return FALSE;
+	// the caches hold exactly the parts with faces of the last cook, split objects show theirs on the child nodes
+	size_t meshParts = outSplit ? 0 : (proxyMesh ? proxyCache.size() : geomCache.size());
+	return meshParts ? FALSE : TRUE;
+}
+
+bool HoudiniEngineMesh::UpdateParticles(INode* node, TimeValue t)
+{
+	UpdateMesh(t);
+	return true;
+}
+
+// particles are not part of the mesh, the bounds have to include them
+void HoudiniEngineMesh::GetLocalBoundBox(TimeValue t, INode* inode, ViewExp* vpt, Box3& box)
+{
+	SimpleObject2::GetLocalBoundBox(t, inode, vpt, box);
+	if ( particles.count() )
+	{
+		box += Point3(particles.boundsMin[0], particles.boundsMin[1], particles.boundsMin[2]);
+		box += Point3(particles.boundsMax[0], particles.boundsMax[1], particles.boundsMax[2]);
+	}
+}
+
+void HoudiniEngineMesh::GetWorldBoundBox(TimeValue t, INode* inode, ViewExp* vpt, Box3& box)
+{
+	SimpleObject2::GetWorldBoundBox(t, inode, vpt, box);
+	if ( particles.count() )
+	{
+		Box3 local(Point3(particles.boundsMin[0], particles.boundsMin[1], particles.boundsMin[2]),
+			Point3(particles.boundsMax[0], particles.boundsMax[1], particles.boundsMax[2]));
+		box += local * inode->GetObjectTM(t);
+	}
+}
+
 RefTargetHandle HoudiniEngineMesh::Clone(RemapDir& remap) 
 {
 	HoudiniEngineMesh* newob = new HoudiniEngineMesh();	
@@ -655,6 +1115,30 @@ INT_PTR MainDlgProc::DlgProc(
 				}
 			}
 			break;
+		case IDC_CREATE_SPLINES_BUTTON:
+			{
+				if ( obj->CreateSplines() )
+				{
+					GetCOREInterface()->RedrawViews(t);
+				}
+			}
+			break;
+		case IDC_CREATE_INSTANCES_BUTTON:
+			{
+				if ( obj->CreateInstances() )
+				{
+					GetCOREInterface()->RedrawViews(t);
+				}
+			}
+			break;
+		case IDC_CREATE_OBJECTS_BUTTON:
+			{
+				if ( obj->CreateObjectNodes() )
+				{
+					GetCOREInterface()->RedrawViews(t);
+				}
+			}
+			break;
 		default:
 			break;
 		}
@@ -8,20 +8,33 @@
 #include "Simpobj.h"
 #include "meshadj.h"
 #include "XTCObject.h"
+#include <IParticleObjectExt.h>
 
 #include "HoudiniEngine.h"
 #include "HoudiniEngine_gui.h"
 #include "HoudiniEngine_input.h"
 #include "HoudiniEngine_util.h"
+#include "HoudiniEngine_cache.h"
 
 #define HOUDINENGINE_INPUT_MAX		(10)
 #define THREAD_ASSET				(1)
+#define PROXY_POINTS_MAX			(100000)
 
 #define PBLOCK_REF  SIMPMOD_PBLOCKREF
 
 //#define USE_NOTIFYREFCHANGED
 
-class HoudiniEngineMesh : public SimpleObject2
+// a HAPI object of a split asset, see HoudiniEngineObject
+struct HoudiniEngineObjectState
+{
+	HAPI_ObjectId		id;
+	std::string			name;				// display name, the map key is the node path
+	int					geoGeneration;		// bumped whenever its geos changed
+	int					xformGeneration;	// bumped whenever its transform changed
+	Matrix3				transform;			// relative to the asset node
+};
+
+class HoudiniEngineMesh : public SimpleObject2, public IParticleObjectExt
 {
 public:
 	static IObjParam					*ip;
@@ -37,8 +50,13 @@ public:
 	virtual const MCHAR *GetObjectName() { return GetString(IDS_CLASS_NAME_GEOM); }
 	//Interval GetValidity(TimeValue t);
 
+	virtual BaseInterface* GetInterface(Interface_ID id);
+	virtual void GetLocalBoundBox(TimeValue t, INode* inode, ViewExp* vpt, Box3& box);
+	virtual void GetWorldBoundBox(TimeValue t, INode* inode, ViewExp* vpt, Box3& box);
+
 	// From Object
 	virtual Interval ObjectValidity(TimeValue t) { Interval iv; iv.Set(t,t); return iv; }
+	virtual BOOL IsParticleSystem();
 
 	// From Animatable
 	virtual void BeginEditParams( IObjParam  *ip, ULONG flags,Animatable *prev);
@@ -50,6 +68,22 @@ public:
 	virtual void GetClassName(TSTR& s) {s = GetString(IDS_CLASS_NAME_GEOM);}
 
 	virtual RefTargetHandle Clone( RemapDir &remap );
+
+	// From Object
+	virtual int CanConvertToType(Class_ID obtype);
+	virtual Object* ConvertToType(TimeValue t, Class_ID obtype);
+
+	// From GeomObject, full resolution geometry when the viewport only shows a proxy
+	virtual Mesh* GetRenderMesh(TimeValue t, INode *inode, View& view, BOOL& needDelete);
+
+	// From IParticleObjectExt, point-only parts of the asset
+	virtual bool UpdateParticles(INode* node, TimeValue t);
+	virtual int NumParticles() { return particles.count(); }
+	virtual int GetParticleBornIndex(int i) { return particles.ids[i]; }
+	virtual Point3* GetParticlePositionByIndex(int i) { return (Point3*)&particles.positions[i*3]; }
+	virtual Point3* GetParticleSpeedByIndex(int i) { return (Point3*)&particles.velocities[i*3]; }
+	virtual TimeValue GetParticleAgeByIndex(int i) { return SecToTicks(particles.ages[i]); }
+	virtual float GetParticleScaleByIndex(int i) { return particles.scales[i]; }
 #if defined(USE_NOTIFYREFCHANGED)
 
 #if MAX_VERSION_MAJOR >= 17
@@ -103,10 +137,24 @@ public:
 	bool LoadAsset();
 	bool UpdateParameters(TimeValue t);
 	bool CreateMaterial();
+	bool CreateInstances();
+	bool CreateSplines();
+	bool CreateObjectNodes();
+	const HoudiniEngineObjectState* FindObjectState(const std::string& path) const;
+	int ForceGeneration() const { return forceGeneration; }
+	float OutputScale() const { return outScale; }
+	bool DeformOnly(TimeValue t);
+	// how long a cook result stays valid, the object nodes use it instead of [t,t]
+	Interval CookValidity(TimeValue t);
+	// primitive groups of the output faces, empty in split mode
+	const std::vector<util::FaceGroup>& GetFaceGroups(TimeValue t);
 	bool SetInputNode(int ch, INode* node);
 	INode* GetINode();
 
 private:
+	void UpdateObjectStates(float scl, bool force);
+	void BuildRenderMesh(TimeValue t);
+
 	void StartProgress()
 	{
 		if ( hProgress )
@@ -138,6 +186,20 @@ private:
 	TSTR								otlFilename;
 	bool								reCook;
 	float								outScale;
+	bool								outPolygons;
+	int									outDisplayMode;
+	bool								proxyMesh;		// mesh is a bounding box or point proxy
+	bool								renderForce;	// renderMesh has to be rebuilt from scratch
+	Mesh								renderMesh;
+	bool								outSplit;
+	int									forceGeneration;	// bumped on every forced update
+	std::map<std::string, HoudiniEngineObjectState>	objectStates;	// by object node path, split mode only
+	GeometryCache						geomCache;
+	GeometryCache						proxyCache;		// box corners or point samples per part, proxy modes only
+	std::vector<util::FaceGroup>		faceGroups;
+	bool								faceGroupsDirty;	// geomCache was assembled again since faceGroups
+	MNMesh								polyMesh;		// polygon mode only, kept next to the tri mesh, not instead of it
+	ParticleCloud						particles;
 };
 
 
@@ -0,0 +1,226 @@
+#include "HoudiniEngine.h"
+#include "HoudiniEngine_object.h"
+#include <set>
+
+class HoudiniEngineObjectClassDesc : public ClassDesc2
+{
+public:
+	virtual int IsPublic() 							{ return FALSE; }
+	virtual void* Create(BOOL /*loading = FALSE*/) 	{ return new HoudiniEngineObject(); }
+	virtual const MCHAR *	ClassName() 			{ return GetString(IDS_CLASS_NAME_OBJECT); }
+	virtual SClass_ID SuperClassID() 				{ return GEOMOBJECT_CLASS_ID; }
+	virtual Class_ID ClassID() 						{ return HOUDINIENGINE_OBJECT_CLASS_ID; }
+	virtual const MCHAR* Category() 				{ return GetString(IDS_CATEGORY); }
+	virtual const MCHAR* InternalName() 			{ return GetString(IDS_CLASS_NAME_OBJECT); }
+	virtual HINSTANCE HInstance() 					{ return hInstance; }
+};
+
+ClassDesc2* GetHoudiniEngineObjectDesc() {
+	static HoudiniEngineObjectClassDesc HoudiniEngineObjectDesc;
+	return &HoudiniEngineObjectDesc;
+}
+
+enum { houdiniengine_object_params };
+enum {
+	pb_object_name,
+	pb_base_transform
+};
+
+static ParamBlockDesc2 houdiniengine_object_param_blk (
+	houdiniengine_object_params, _T("Houdini Engine Object"),  0, GetHoudiniEngineObjectDesc(),
+	P_AUTO_CONSTRUCT, PBLOCK_REF,
+	// params
+	pb_object_name,		_T("object"),		TYPE_STRING, 	0,  IDS_HE_OBJECT_NAME,
+	p_default,			_T(""),
+	p_end,
+	pb_base_transform,	_T("basetransform"),	TYPE_MATRIX3, 	0,  IDS_HE_BASE_TRANSFORM,
+	p_end,
+	p_end
+	);
+
+// max does not allow scene changes from inside the object pipeline, so BuildMesh only queues the
+// objects whose transform changed and the nodes are moved after the views were redrawn
+class ObjectTransformCallback : public RedrawViewsCallback
+{
+public:
+	std::set<HoudiniEngineObject*>	pending;
+	int								users;
+
+	ObjectTransformCallback() { users = 0; }
+
+	virtual void proc(Interface* ip)
+	{
+		std::set<HoudiniEngineObject*> objects;
+		objects.swap(pending);
+		for ( std::set<HoudiniEngineObject*>::iterator it = objects.begin(); it != objects.end(); ++it )
+			(*it)->ApplyTransform(ip->GetTime());
+	}
+};
+
+static ObjectTransformCallback transformCallback;
+
+HoudiniEngineObject::HoudiniEngineObject()
+{
+	source = NULL;
+	ResetOutput();
+	GetHoudiniEngineObjectDesc()->MakeAutoParamBlocks(this);
+	if ( transformCallback.users++ == 0 )
+		GetCOREInterface()->RegisterRedrawViewsCallback(&transformCallback);
+}
+
+HoudiniEngineObject::~HoudiniEngineObject()
+{
+	transformCallback.pending.erase(this);
+	if ( --transformCallback.users == 0 )
+		GetCOREInterface()->UnRegisterRedrawViewsCallback(&transformCallback);
+	DeleteAllRefs();
+}
+
+void HoudiniEngineObject::SetSource(HoudiniEngineMesh* asset, const std::string& path, const Matrix3& transform)
+{
+	pblock2->SetValue(pb_object_name, 0, TSTR::FromUTF8(path.c_str()).data());
+	pblock2->SetValue(pb_base_transform, 0, const_cast<Matrix3&>(transform));
+	ReplaceReference(1, asset);
+	ResetOutput();
+}
+
+RefTargetHandle HoudiniEngineObject::GetReference(int i)
+{
+	return i == 1 ? (RefTargetHandle)source : (RefTargetHandle)pblock2;
+}
+
+void HoudiniEngineObject::SetReference(int i, RefTargetHandle rtarg)
+{
+	if ( i == 1 )
+		source = (HoudiniEngineMesh*)rtarg;
+	else
+		pblock2 = (IParamBlock2*)rtarg;
+}
+
+// a change of the asset object only invalidates, BuildMesh compares the generations of the next
+// cook and leaves the mesh alone when this object did not change
+#if MAX_VERSION_MAJOR >= 17
+RefResult HoudiniEngineObject::NotifyRefChanged(const Interval& changeInt, RefTargetHandle hTarget, PartID& partID, RefMessage message, BOOL propagate)
+#else
+RefResult HoudiniEngineObject::NotifyRefChanged(Interval changeInt, RefTargetHandle hTarget, PartID& partID, RefMessage message)
+#endif
+{
+	if ( hTarget == source && message == REFMSG_CHANGE )
+		ivalid.SetEmpty();
+#if MAX_VERSION_MAJOR >= 17
+	return SimpleObject2::NotifyRefChanged(changeInt, hTarget, partID, message, propagate);
+#else
+	return SimpleObject2::NotifyRefChanged(changeInt, hTarget, partID, message);
+#endif
+}
+
+RefTargetHandle HoudiniEngineObject::Clone(RemapDir& remap)
+{
+	HoudiniEngineObject* newob = new HoudiniEngineObject();
+	newob->ReplaceReference(0, remap.CloneRef(pblock2));
+	newob->ReplaceReference(1, source);
+	newob->ivalid.SetEmpty();
+	BaseClone(this, newob, remap);
+	return(newob);
+}
+
+void HoudiniEngineObject::ResetOutput()
+{
+	geomCache.clear();
+	faceGroups.clear();
+	faceGroupsDirty = false;
+	outForce = -1;
+	outGeo = -1;
+	outXform = -1;
+}
+
+const HoudiniEngineObjectState* HoudiniEngineObject::GetState()
+{
+	if ( !source )
+		return NULL;
+	std::string path = CStr::FromMCHAR(pblock2->GetStr(pb_object_name)).data();
+	return source->FindObjectState(path);
+}
+
+// pb_base_transform is the houdini transform the nodes were last moved to. the nodes are moved by the
+// change since then in the space of their parent, so a move of the user and the object offset stay
+void HoudiniEngineObject::ApplyTransform(TimeValue t)
+{
+	const HoudiniEngineObjectState* state = GetState();
+	if ( !state )
+		return;
+	Matrix3 applied = pblock2->GetMatrix3(pb_base_transform);
+	Matrix3 transform = state->transform;
+	if ( applied == transform )
+		return;
+
+	MyEnumProc dep(false);
+	DoEnumDependents(&dep);
+	theHold.Suspend();
+	SuspendAnimate();
+	AnimateOff();
+	for ( int i = 0; i < dep.Nodes.Count(); ++i )
+	{
+		INode* node = dep.Nodes[i];
+		Object* obj = node->GetObjectRef();
+		if ( !obj || obj->FindBaseObject() != this )
+			continue;
+		INode* parent = node->GetParentNode();
+		Matrix3 parentTM = parent ? parent->GetObjectTM(t) : Matrix3(1);
+		Matrix3 tm = node->GetNodeTM(t) * Inverse(applied * parentTM) * (transform * parentTM);
+		node->SetNodeTM(t, tm);
+	}
+	pblock2->SetValue(pb_base_transform, 0, transform);
+	ResumeAnimate();
+	theHold.Resume();
+}
+
+void HoudiniEngineObject::BuildMesh(TimeValue t)
+{
+	// cooks the asset for t and updates the object states
+	const HoudiniEngineObjectState* state = NULL;
+	ivalid = FOREVER;
+	if ( source )
+	{
+		source->UpdateMesh(t);
+		ivalid = source->CookValidity(t);
+		state = GetState();
+	}
+
+	if ( !state )
+	{
+		if ( mesh.getNumVerts() || mesh.getNumFaces() )
+		{
+			mesh.FreeAll();
+			mesh.InvalidateTopologyCache();
+		}
+		ResetOutput();
+		return;
+	}
+
+	// the mesh stays in the space of the houdini object at creation
+	bool force = outForce != source->ForceGeneration();
+	if ( force || outGeo != state->geoGeneration )
+	{
+		bool changed = util::BuildMeshFromCookResult( mesh, geomCache, source->asset_id(),
+			source->OutputScale(), force, source->DeformOnly(t), NULL, state->id );
+		faceGroupsDirty = faceGroupsDirty || changed;
+	}
+	if ( force || outXform != state->xformGeneration )
+		transformCallback.pending.insert(this);
+
+	outForce = source->ForceGeneration();
+	outGeo = state->geoGeneration;
+	outXform = state->xformGeneration;
+}
+
+const std::vector<util::FaceGroup>& HoudiniEngineObject::GetFaceGroups(TimeValue t)
+{
+	UpdateMesh(t);
+	if ( faceGroupsDirty )
+	{
+		util::GetFaceGroups( geomCache, mesh.getNumFaces(), faceGroups );
+		faceGroupsDirty = false;
+	}
+	return faceGroups;
+}
@@ -0,0 +1,70 @@
+#ifndef __HOUDINIENGINE_OBJECT__
+#define __HOUDINIENGINE_OBJECT__
+
+#include "HoudiniEngine_mesh.h"
+
+// one HAPI object of a split asset, created as a child node by HoudiniEngineMesh::CreateObjectNodes.
+// it only rebuilds its mesh when the geos of its own object changed, a transform change only moves its nodes
+class HoudiniEngineObject : public SimpleObject2
+{
+public:
+	HoudiniEngineObject();
+	virtual ~HoudiniEngineObject();
+
+	virtual void DeleteThis() { delete this; }
+
+	// From BaseObject
+	virtual CreateMouseCallBack* GetCreateMouseCallBack() { return NULL; }
+	virtual const MCHAR *GetObjectName() { return GetString(IDS_CLASS_NAME_OBJECT); }
+
+	// From Object
+	virtual Interval ObjectValidity(TimeValue t) { UpdateMesh(t); return ivalid; }
+
+	//From Animatable
+	virtual Class_ID ClassID() {return HOUDINIENGINE_OBJECT_CLASS_ID;}
+	virtual SClass_ID SuperClassID() { return GEOMOBJECT_CLASS_ID; }
+	virtual void GetClassName(TSTR& s) {s = GetString(IDS_CLASS_NAME_OBJECT);}
+
+	virtual RefTargetHandle Clone( RemapDir &remap );
+
+	virtual int	NumParamBlocks() { return 1; }
+	virtual IParamBlock2* GetParamBlock(int i) { return pblock2; }
+	virtual IParamBlock2* GetParamBlockByID(BlockID id) { return (pblock2->ID() == id) ? pblock2 : NULL; }
+
+	// reference 0 is the param block, 1 the asset object
+	virtual int NumRefs() { return 2; }
+	virtual RefTargetHandle GetReference(int i);
+#if MAX_VERSION_MAJOR >= 17
+	virtual RefResult NotifyRefChanged(const Interval& changeInt, RefTargetHandle hTarget, PartID& partID, RefMessage message, BOOL propagate);
+#else
+	virtual RefResult NotifyRefChanged(Interval changeInt, RefTargetHandle hTarget, PartID& partID, RefMessage message);
+#endif
+
+	void BuildMesh(TimeValue t);
+
+	// path is the HAPI object node path, the key of HoudiniEngineMesh::FindObjectState
+	void SetSource(HoudiniEngineMesh* asset, const std::string& path, const Matrix3& transform);
+	// moves the nodes to the current houdini transform, only outside the object pipeline
+	void ApplyTransform(TimeValue t);
+	// primitive groups of the faces of this object
+	const std::vector<util::FaceGroup>& GetFaceGroups(TimeValue t);
+
+protected:
+	virtual void SetReference(int i, RefTargetHandle rtarg);
+
+private:
+	void ResetOutput();
+	const HoudiniEngineObjectState* GetState();
+
+	HoudiniEngineMesh*					source;
+	GeometryCache						geomCache;
+	std::vector<util::FaceGroup>		faceGroups;
+	bool								faceGroupsDirty;
+	int									outForce;
+	int									outGeo;
+	int									outXform;
+};
+
+extern ClassDesc2* GetHoudiniEngineObjectDesc();
+
+#endif // __HOUDINIENGINE_OBJECT__
@@ -0,0 +1,67 @@
+#ifndef __HOUDINIENGINE_PARALLEL__
+#define __HOUDINIENGINE_PARALLEL__
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+// std::thread is used instead of tbb, max ships its own tbb that conflicts with ours
+namespace util
+{
+	// number of worker threads, 0 = hardware concurrency
+	inline int GetWorkerCount( int requested = 0 )
+	{
+		int n = requested > 0 ? requested : (int)std::thread::hardware_concurrency();
+		return n > 0 ? n : 1;
+	}
+
+	// calls func(i) for every i in [0, count), items are handed out one at a time
+	template<class Func>
+	void ParallelFor( int count, const Func& func, int numThreads = 0 )
+	{
+		int workers = GetWorkerCount(numThreads);
+		if ( workers > count )
+			workers = count;
+
+		if ( workers <= 1 )
+		{
+			for ( int i = 0; i < count; ++i )
+				func(i);
+			return;
+		}
+
+		std::atomic<int> next(0);
+		auto worker = [&]()
+		{
+			for ( int i = next++; i < count; i = next++ )
+				func(i);
+		};
+
+		std::vector<std::thread> threads;
+		threads.reserve(workers - 1);
+		for ( int t = 1; t < workers; ++t )
+			threads.push_back(std::thread(worker));
+
+		// the calling thread works too
+		worker();
+
+		for ( size_t t = 0; t < threads.size(); ++t )
+			threads[t].join();
+	}
+
+	// calls func(begin, end) for consecutive ranges of at most chunk items, for loops
+	// where one item is too little work to hand out on its own
+	template<class Func>
+	void ParallelForRanges( int count, int chunk, const Func& func, int numThreads = 0 )
+	{
+		int ranges = (count + chunk - 1) / chunk;
+		ParallelFor( ranges, [&]( int r )
+		{
+			int begin = r * chunk;
+			func( begin, std::min( count, begin + chunk ) );
+		}, numThreads );
+	}
+};
+
+#endif // __HOUDINIENGINE_PARALLEL__
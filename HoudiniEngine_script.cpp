@@ -1,6 +1,8 @@
 #include "HoudiniEngine.h"
 #include "HoudiniEngine_util.h"
 #include "HoudiniEngine_gui.h"
+#include "HoudiniEngine_object.h"
+#include <maxscript/mxsplugin/mxsPlugin.h>
 
 #define HOUDINIENGINE_FP_INTERFACE_ID Interface_ID(0x661f5198, 0x78814977)
 
@@ -20,6 +22,9 @@ class HoudiniEngineFunctionInterface : public FPStaticInterface {
 			kInstantiateAsset,
 			kDestroyAsset,
 			kGeneratePluginScript,
+			kGetFaceGroupCount,
+			kGetFaceGroupName,
+			kGetFaceGroup,
 			};
 
 		static BOOL Initialize();
@@ -33,6 +38,9 @@ class HoudiniEngineFunctionInterface : public FPStaticInterface {
 		static int InstantiateAsset(  const MCHAR* name, BOOL cook_on_load );
 		static BOOL DestroyAsset( int asset_id );
 		static BOOL GeneratePluginScript(const MCHAR* otl_filename, const MCHAR* name, const MCHAR* category, const MCHAR* texture_path, const MCHAR* mxs_filename);
+		static int GetFaceGroupCount( INode* node );
+		static TSTR GetFaceGroupName( INode* node, int index );
+		static BitArray GetFaceGroup( INode* node, const MCHAR* name );
 
 		BEGIN_FUNCTION_MAP			
 
@@ -47,6 +55,9 @@ class HoudiniEngineFunctionInterface : public FPStaticInterface {
 			FN_2(kInstantiateAsset, TYPE_INT, InstantiateAsset, TYPE_STRING, TYPE_BOOL)
 			FN_1(kDestroyAsset, TYPE_BOOL, DestroyAsset, TYPE_INT)
 			FN_5(kGeneratePluginScript, TYPE_BOOL, GeneratePluginScript, TYPE_STRING, TYPE_STRING, TYPE_STRING, TYPE_STRING, TYPE_STRING)
+			FN_1(kGetFaceGroupCount, TYPE_INT, GetFaceGroupCount, TYPE_INODE)
+			FN_2(kGetFaceGroupName, TYPE_STRING, GetFaceGroupName, TYPE_INODE, TYPE_INDEX)
+			FN_2(kGetFaceGroup, TYPE_BITARRAY_BV, GetFaceGroup, TYPE_INODE, TYPE_STRING)
 
 		END_FUNCTION_MAP
 
@@ -78,6 +89,15 @@ static HoudiniEngineFunctionInterface theHoudiniEngineFunctionInterface (
 		_T("category"), 0, TYPE_STRING,
 		_T("texture_path"), 0, TYPE_STRING,
 		_T("mxs_filename"), 0, TYPE_STRING,
+
+	HoudiniEngineFunctionInterface::kGetFaceGroupCount, _T("GetFaceGroupCount"), 0, TYPE_INT, 0, 1,
+		_T("node"), 0, TYPE_INODE,
+	HoudiniEngineFunctionInterface::kGetFaceGroupName, _T("GetFaceGroupName"), 0, TYPE_STRING, 0, 2,
+		_T("node"), 0, TYPE_INODE,
+		_T("index"), 0, TYPE_INDEX,
+	HoudiniEngineFunctionInterface::kGetFaceGroup, _T("GetFaceGroup"), 0, TYPE_BITARRAY_BV, 0, 2,
+		_T("node"), 0, TYPE_INODE,
+		_T("name"), 0, TYPE_STRING,
 	p_end);
 
 #include <fstream>
@@ -235,3 +255,56 @@ BOOL HoudiniEngineFunctionInterface::DestroyAsset( int asset_id )
 
 
 
+
+// face groups of an asset node or of one of its object nodes, scripted asset plugins hand out their delegate
+static const std::vector<util::FaceGroup>* GetNodeFaceGroups( INode* node )
+{
+	if ( !node || !node->GetObjectRef() )
+		return NULL;
+
+	TimeValue t = GetCOREInterface()->GetTime();
+	Object* obj = node->GetObjectRef()->FindBaseObject();
+	if ( obj->ClassID() == HOUDINIENGINE_OBJECT_CLASS_ID )
+		return &((HoudiniEngineObject*)obj)->GetFaceGroups(t);
+
+	if ( obj->ClassID() != HOUDINIENGINE_MESH_CLASS_ID )
+	{
+		MSPlugin* plugin = (MSPlugin*)obj->GetInterface(I_MAXSCRIPTPLUGIN);
+		obj = plugin ? (Object*)plugin->get_delegate() : NULL;
+		if ( !obj || obj->ClassID() != HOUDINIENGINE_MESH_CLASS_ID )
+			return NULL;
+	}
+	return &((HoudiniEngineMesh*)obj)->GetFaceGroups(t);
+}
+
+int HoudiniEngineFunctionInterface::GetFaceGroupCount( INode* node )
+{
+	const std::vector<util::FaceGroup>* groups = GetNodeFaceGroups( node );
+	return groups ? (int)groups->size() : 0;
+}
+
+TSTR HoudiniEngineFunctionInterface::GetFaceGroupName( INode* node, int index )
+{
+	TSTR result;
+	const std::vector<util::FaceGroup>* groups = GetNodeFaceGroups( node );
+	if ( groups && index >= 0 && index < (int)groups->size() )
+	{
+		result = TSTR::FromUTF8( (*groups)[index].name.c_str() );
+	}
+	return result;
+}
+
+BitArray HoudiniEngineFunctionInterface::GetFaceGroup( INode* node, const MCHAR* name )
+{
+	const std::vector<util::FaceGroup>* groups = GetNodeFaceGroups( node );
+	if ( groups && name )
+	{
+		std::string groupName = CStr::FromMCHAR(name).data();
+		for ( size_t i = 0; i < groups->size(); ++i )
+		{
+			if ( (*groups)[i].name == groupName )
+				return (*groups)[i].faces;
+		}
+	}
+	return BitArray();
+}
@@ -1,6 +1,12 @@
 #include <iostream>
+#include <algorithm>
+#include <float.h>
 #include "HoudiniEngine.h"
 #include "HoudiniEngine_util.h"
+#include "HoudiniEngine_cache.h"
+#include "HoudiniEngine_hash.h"
+#include "HoudiniEngine_convert.h"
+#include "HoudiniEngine_parallel.h"
 #include <stdmat.h>
 #include <maxscript\maxscript.h>
 #include <sstream>
@@ -41,67 +47,46 @@ namespace util
 		return -1;
 	}
 
-	// from asciiexp/export.cpp
-	Point3 GetVertexNormal(Mesh* mesh, int faceNo, RVertex* rv)
+	// tm followed by max z-up to houdini y-up and unit scale: (x, z, -y) * scl
+	void GetHoudiniTransform(const Matrix3& tm, float scl, float m[3][4])
 	{
-		Face* f = &mesh->faces[faceNo];
-		DWORD smGroup = f->smGroup;
-		int numNormals = 0;
-		Point3 vertexNormal;
-
-		// Is normal specified
-		// SPCIFIED is not currently used, but may be used in future versions.
-		if (rv->rFlags & SPECIFIED_NORMAL) {
-			vertexNormal = rv->rn.getNormal();
-		}
-		// If normal is not specified it's only available if the face belongs
-		// to a smoothing group
-		else if ((numNormals = rv->rFlags & NORCT_MASK) != 0 && smGroup) {
-			// If there is only one vertex is found in the rn member.
-			if (numNormals == 1) {
-				vertexNormal = rv->rn.getNormal();
-			}
-			else {
-				// If two or more vertices are there you need to step through them
-				// and find the vertex with the same smoothing group as the current face.
-				// You will find multiple normals in the ern member.
-				for (int i = 0; i < numNormals; i++) {
-					if (rv->ern[i].getSmGroup() & smGroup) {
-						vertexNormal = rv->ern[i].getNormal();
-					}
-				}
-			}
-		}
-		else {
-			// Get the normal from the Face if no smoothing groups are there
-			vertexNormal = mesh->getFaceNormal(faceNo);
+		for (int i = 0; i < 4; i++)
+		{
+			Point3 row = tm.GetRow(i);
+			m[0][i] = row.x * scl;
+			m[1][i] = row.z * scl;
+			m[2][i] = -row.y * scl;
 		}
-
-		return vertexNormal;
 	}
 
-	static BOOL SetNumTVFaces( Mesh& mesh, int oldsize, int newsize )
+	// tm in houdini space as a row major 4x4 matrix: the same transform applied to points that were
+	// converted with GetHoudiniTransform(Matrix3(1), scl). false if tm mirrors or shears,
+	// a houdini object transform cannot hold that
+	bool GetHoudiniMatrix(const Matrix3& tm, float scl, float m[16])
 	{
-		if ( !mesh.tvFace )
-		{
-			return mesh.setNumTVFaces( newsize );
-		}
-
-		TVFace* tvface = new TVFace[oldsize];
-		for ( int i = 0; i < oldsize; i ++ )
+		// houdini axis a is max axis axes[a] times signs[a]
+		const int axes[3] = { 0, 2, 1 };
+		const float signs[3] = { 1.f, 1.f, -1.f };
+		for (int a = 0; a < 3; a++)
 		{
-			tvface[i] = mesh.tvFace[i];
-		}
-		if ( mesh.setNumTVFaces( newsize /*, TRUE, oldsize*/ ) )
-		{
-			for ( int i = 0; i < oldsize && i < newsize; i ++ )
-			{
-				mesh.tvFace[i] = tvface[i];
-			}
+			Point3 row = tm.GetRow(axes[a]);
+			for (int b = 0; b < 3; b++)
+				m[a*4+b] = row[axes[b]] * signs[a] * signs[b];
+			m[a*4+3] = 0.f;
 		}
-		delete [] tvface;
-
-		return TRUE;
+		Point3 trans = tm.GetTrans();
+		m[12] = trans.x * scl;
+		m[13] = trans.z * scl;
+		m[14] = -trans.y * scl;
+		m[15] = 1.f;
+
+		Point3 r0 = tm.GetRow(0), r1 = tm.GetRow(1), r2 = tm.GetRow(2);
+		if (DotProd(CrossProd(r0, r1), r2) <= 0.f)
+			return false;
+		const float eps = 1e-4f;
+		return fabsf(DotProd(r0, r1)) <= eps * r0.Length() * r1.Length()
+			&& fabsf(DotProd(r1, r2)) <= eps * r1.Length() * r2.Length()
+			&& fabsf(DotProd(r0, r2)) <= eps * r0.Length() * r2.Length();
 	}
 
 	static void MakeQuad(int nverts, Face *f, int a, int b , int c , int d, int sg, int bias) {
@@ -582,481 +567,1703 @@ namespace util
 		mesh.InvalidateTopologyCache();
 	}
 
-	void BuildMeshFromCookResult( Mesh& mesh, HAPI_AssetId asset_id, float scl, bool forceUpdate )
+	// cooked part in traversal order
+	struct CookPart
 	{
-		HAPI_Result hstat = HAPI_RESULT_SUCCESS;
-		HAPI_AssetId myAssetId( asset_id );
-		HAPI_PartInfo myPartInfo;
-		HAPI_AssetInfo asset_info;
+		PartKey			key;
+		HAPI_PartInfo	info;
+		bool			dirty;
+		bool			pointsOnly;
+		int				groupCount;		// primitive groups of the geo
+	};
+
+	// face counts and vertex list of a part
+	struct PartTopology
+	{
+		std::vector<int>	polyCount;
+		std::vector<int>	polyConnect;
+	};
 
-		HAPI_GetAssetInfo(hapi::Engine::instance()->session(), myAssetId, &asset_info);
-		if ( asset_info.objectCount )
+	static PartFingerprint GetPartFingerprint( const HAPI_PartInfo& info )
+	{
+		PartFingerprint fp;
+		fp.faceCount			= info.faceCount;
+		fp.vertexCount			= info.vertexCount;
+		fp.pointCount			= info.pointCount;
+		fp.pointAttributeCount	= info.pointAttributeCount;
+		fp.faceAttributeCount	= info.faceAttributeCount;
+		fp.vertexAttributeCount	= info.vertexAttributeCount;
+		fp.detailAttributeCount	= info.detailAttributeCount;
+		return fp;
+	}
+
+	// uv -> 1, uv2..uv99 -> 2..99, anything else -> 0
+	static int GetUVChannel( const std::string& name )
+	{
+		if ( name.size() < 2 || name.compare(0, 2, "uv") != 0 )
+			return 0;
+		if ( name.size() == 2 )
+			return 1;
+		if ( name.size() > 4 || name[2] == '0' )
+			return 0;
+
+		int channel = 0;
+		for ( size_t i = 2; i < name.size(); ++i )
 		{
-			HAPI_ObjectInfo* oinfo = new HAPI_ObjectInfo[ asset_info.objectCount ];
-			HAPI_GetObjects(hapi::Engine::instance()->session(), myAssetId, oinfo, 0, asset_info.objectCount);
-			bool needUpdateGeo = forceUpdate;
+			if ( name[i] < '0' || name[i] > '9' )
+				return 0;
+			channel = channel * 10 + (name[i] - '0');
+		}
+		return channel >= 2 && channel < MAX_MESHMAPS ? channel : 0;
+	}
+
+	static std::string GetUVName( int channel, const char* base )
+	{
+		return channel == 1 ? std::string(base) : std::string(base) + std::to_string(channel);
+	}
+
+	// uv attribute found on a part
+	struct UVAttribute
+	{
+		int						channel;
+		HAPI_AttributeOwner		owner;
+		bool					hasNumber;	// uvNumber of the same channel exists
+	};
+
+	static bool LessChannel( const UVAttribute& a, const UVAttribute& b )
+	{
+		return a.channel < b.channel;
+	}
+
+	// list the point and vertex attributes once and pick up every uv channel, point wins over vertex
+	static void FindUVAttributes( HAPI_AssetId asset_id, const PartKey& key, std::vector<UVAttribute>& uvs )
+	{
+		hapi::Part part(asset_id, key.object, key.geo, key.part);
+		HAPI_AttributeOwner owners[2] = { HAPI_ATTROWNER_POINT, HAPI_ATTROWNER_VERTEX };
+		std::vector<std::string> names[2];
+		try
+		{
+			for ( int i = 0; i < 2; i++ )
+				names[i] = part.attribNames(owners[i]);
+		}
+		catch ( hapi::Failure& )
+		{
+			return;
+		}
+
+		bool found[MAX_MESHMAPS] = { false };
+		for ( int i = 0; i < 2; i++ )
+		{
+			for ( size_t n = 0; n < names[i].size(); ++n )
+			{
+				int channel = GetUVChannel(names[i][n]);
+				if ( !channel || found[channel] )
+					continue;
+
+				found[channel] = true;
+				UVAttribute uv;
+				uv.channel = channel;
+				uv.owner = owners[i];
+				uv.hasNumber = std::find(names[i].begin(), names[i].end(), GetUVName(channel, "uvNumber")) != names[i].end();
+				uvs.push_back(uv);
+			}
+		}
+		std::sort(uvs.begin(), uvs.end(), LessChannel);
+	}
+
+	// elements per HAPI read, large parts are fetched in windows of this size so a single
+	// transfer never needs a full size buffer on either side of the session. a part above it is
+	// not kept in the cache after assembly either, see IsLargePart.
+	// fetch_chunk_size in HoudiniEngine.ini, 0 or missing = default. read on every call so a change
+	// from the settings dialog applies to the next cook, the ini read is small next to a transfer
+	static int GetFetchChunkSize()
+	{
+		int value = GetProfileInt(_T("fetch_chunk_size"));
+		return value > 0 ? value : 1 << 20;
+	}
+
+	// a part with more points, faces or vertices than one fetch window only lives in the mesh
+	// between cooks. its block is released after assembly so the plugin holds one copy of it,
+	// the price is a new fetch whenever the mesh has to be assembled again
+	static bool IsLargePart( const HAPI_PartInfo& info, int chunk )
+	{
+		return info.pointCount > chunk || info.faceCount > chunk || info.vertexCount > chunk;
+	}
+
+	// sort_faces_by_material in HoudiniEngine.ini, read per cook so a change applies to the next one.
+	// off unless it is 1, a missing key reads as -1 and must not reorder the faces of existing scenes
+	static bool GetSortByMaterial()
+	{
+		return GetProfileInt(_T("sort_faces_by_material")) == 1;
+	}
+
+	static void FetchFloatAttribute( HAPI_AssetId asset_id, const CookPart& part, const char* name, HAPI_AttributeInfo& attr_info, float* dst )
+	{
+		int chunk = GetFetchChunkSize();
+		for ( int start = 0; start < attr_info.count; start += chunk )
+		{
+			HAPI_GetAttributeFloatData(hapi::Engine::instance()->session(),
+				asset_id, part.key.object, part.key.geo, part.key.part,
+				name,
+				&attr_info,
+				dst + (size_t)start * attr_info.tupleSize,
+				start, std::min(chunk, attr_info.count - start)
+				);
+		}
+	}
+
+	static void FetchIntAttribute( HAPI_AssetId asset_id, const CookPart& part, const char* name, HAPI_AttributeInfo& attr_info, int* dst )
+	{
+		int chunk = GetFetchChunkSize();
+		for ( int start = 0; start < attr_info.count; start += chunk )
+		{
+			HAPI_GetAttributeIntData(hapi::Engine::instance()->session(),
+				asset_id, part.key.object, part.key.geo, part.key.part,
+				name,
+				&attr_info,
+				dst + (size_t)start * attr_info.tupleSize,
+				start, std::min(chunk, attr_info.count - start)
+				);
+		}
+	}
+
+	// primitive group membership of a part, one int per face
+	static void FetchGroupMembership( HAPI_AssetId asset_id, const CookPart& part, const char* name, int* dst )
+	{
+		int chunk = GetFetchChunkSize();
+		for ( int start = 0; start < part.info.faceCount; start += chunk )
+		{
+			HAPI_Bool all_equal;
+			int length = std::min(chunk, part.info.faceCount - start);
+			HAPI_GetGroupMembership(hapi::Engine::instance()->session(),
+				asset_id, part.key.object, part.key.geo, part.key.part,
+				HAPI_GROUPTYPE_PRIM, name, &all_equal, dst + start, start, length);
+		}
+	}
+
+	static bool LessGroup( const GroupSource& a, const GroupSource& b )
+	{
+		return a.name < b.name;
+	}
+
+	// every primitive group of the geo that has a face in this part
+	static void FetchGroups( HAPI_AssetId asset_id, const CookPart& part, std::vector<GroupSource>& groups )
+	{
+		if ( part.groupCount <= 0 )
+			return;
+
+		std::vector<HAPI_StringHandle> names(part.groupCount);
+		if ( HAPI_GetGroupNames(hapi::Engine::instance()->session(),
+			asset_id, part.key.object, part.key.geo,
+			HAPI_GROUPTYPE_PRIM, &names.front(), part.groupCount) != HAPI_RESULT_SUCCESS )
+			return;
+
+		groups.reserve(names.size());
+		for ( size_t i = 0; i < names.size(); ++i )
+		{
+			groups.push_back(GroupSource());
+			GroupSource& group = groups.back();
+			group.name = GetString(names[i]);
+			group.membership.resize(part.info.faceCount);
+			FetchGroupMembership( asset_id, part, group.name.c_str(), &group.membership.front() );
+
+			if ( std::find(group.membership.begin(), group.membership.end(), 1) == group.membership.end() )
+				groups.pop_back();
+		}
+		std::sort(groups.begin(), groups.end(), LessGroup);
+	}
+
+	static void FetchTopology( HAPI_AssetId asset_id, const CookPart& part, PartTopology& topo )
+	{
+		topo.polyCount.resize(part.info.faceCount);
+		topo.polyConnect.resize(part.info.vertexCount);
+
+		int chunk = GetFetchChunkSize();
+		for ( int start = 0; start < part.info.faceCount; start += chunk )
+		{
+			HAPI_GetFaceCounts(hapi::Engine::instance()->session(),
+				asset_id, part.key.object, part.key.geo, part.key.part,
+				&topo.polyCount[start],
+				start,
+				std::min(chunk, part.info.faceCount - start)
+				);
+		}
+
+		for ( int start = 0; start < part.info.vertexCount; start += chunk )
+		{
+			HAPI_GetVertexList(hapi::Engine::instance()->session(),
+				asset_id, part.key.object, part.key.geo, part.key.part,
+				&topo.polyConnect[start],
+				start,
+				std::min(chunk, part.info.vertexCount - start)
+				);
+		}
+	}
+
+	static uint64_t TopologyHash( const PartTopology& topo )
+	{
+		uint64_t h = Hash64(&topo.polyCount.front(), topo.polyCount.size() * sizeof(int));
+		if ( topo.polyConnect.size() )
+			h = Hash64(&topo.polyConnect.front(), topo.polyConnect.size() * sizeof(int), h);
+		return h;
+	}
+
+	// fetch P into dst (3 floats per point), still in the houdini coordinate system
+	static void FetchPoints( HAPI_AssetId asset_id, const CookPart& part, float* dst )
+	{
+		HAPI_AttributeInfo attr_info;
+		attr_info.exists = false;
+		HAPI_GetAttributeInfo(hapi::Engine::instance()->session(),
+			asset_id, part.key.object, part.key.geo, part.key.part,
+			"P",
+			HAPI_ATTROWNER_POINT,
+			&attr_info
+			);
+		FetchFloatAttribute( asset_id, part, "P", attr_info, dst );
+	}
+
+	// fetch N from point or vertex, returns HAPI_ATTROWNER_MAX if there is none
+	static HAPI_AttributeOwner FetchNormals( HAPI_AssetId asset_id, const CookPart& part, std::vector<float>& normals )
+	{
+		for ( int i = 0; i < 2; i++ )
+		{
+			HAPI_AttributeOwner owner = i == 0 ? HAPI_ATTROWNER_POINT : HAPI_ATTROWNER_VERTEX;
+			HAPI_AttributeInfo attr_info;
+			attr_info.exists = false;
+			HAPI_GetAttributeInfo(hapi::Engine::instance()->session(),
+				asset_id, part.key.object, part.key.geo, part.key.part,
+				"N",
+				owner,
+				&attr_info
+				);
+			if ( !attr_info.exists || attr_info.tupleSize != 3 || !attr_info.count )
+				continue;
+
+			normals.resize(attr_info.count * 3);
+			FetchFloatAttribute( asset_id, part, "N", attr_info, &normals.front() );
+			return owner;
+		}
+		normals.clear();
+		return HAPI_ATTROWNER_MAX;
+	}
+
+	// fetch a color attribute, vertex wins over point over primitive like in houdini
+	static bool FetchColorAttribute( HAPI_AssetId asset_id, const CookPart& part, const char* name, int channel, PartUV& color )
+	{
+		HAPI_AttributeOwner owners[3] = { HAPI_ATTROWNER_VERTEX, HAPI_ATTROWNER_POINT, HAPI_ATTROWNER_PRIM };
+		AttribOwner mapOwners[3] = { owner_vertex, owner_point, owner_prim };
+		for ( int i = 0; i < 3; i++ )
+		{
+			HAPI_AttributeInfo attr_info;
+			attr_info.exists = false;
+			HAPI_GetAttributeInfo(hapi::Engine::instance()->session(),
+				asset_id, part.key.object, part.key.geo, part.key.part,
+				name,
+				owners[i],
+				&attr_info
+				);
+			if ( !attr_info.exists || !attr_info.count )
+				continue;
+
+			color.channel = channel;
+			color.owner = mapOwners[i];
+			color.tupleSize = attr_info.tupleSize;
+			color.uv.resize(attr_info.count * attr_info.tupleSize);
+			FetchFloatAttribute( asset_id, part, name, attr_info, &color.uv.front() );
+			return true;
+		}
+		return false;
+	}
+
+	// hash of raw P and N, the scale is part of it so a unit change is not mistaken for the same result
+	static uint64_t PointsHash( const float* points, int numPoints, const float* normals, int numNormals, float scl )
+	{
+		uint64_t h = Hash64(&scl, sizeof(scl));
+		h = Hash64(points, numPoints * 3 * sizeof(float), h);
+		if ( numNormals )
+			h = Hash64(normals, numNormals * 3 * sizeof(float), h);
+		return h;
+	}
+
+	// normals of a part whose topology did not change, hash receives the raw normals.
+	// false if the cooked N no longer fits the cached normal layout
+	static bool RefreshPartNormals( HAPI_AssetId asset_id, const CookPart& part, PartBlock& block, uint64_t& hash )
+	{
+		if ( block.normals.empty() )
+			return true;
+
+		size_t count = block.normals.size();
+		FetchNormals( asset_id, part, block.normals );
+		if ( block.normals.size() != count )
+			return false;
+
+		hash = Hash64( &block.normals.front(), count * sizeof(float), hash );
+		ConvertNormals( &block.normals.front(), block.numNormals() );
+		return true;
+	}
+
+	// positions and normals of a part whose topology did not change, written to dst (3 floats per point).
+	// changed is false if they are identical to the last fetch. returns false if the normals do not
+	// fit anymore, the block is left stale and the part has to be fetched and converted again
+	static bool RefreshPartPoints( HAPI_AssetId asset_id, const CookPart& part, float scl, PartBlock& block, float* dst, bool& changed )
+	{
+		FetchPoints( asset_id, part, dst );
+		uint64_t hash = PointsHash( dst, block.numPoints(), NULL, 0, scl );
+		ConvertPoints( dst, block.numPoints(), scl );
+		if ( !RefreshPartNormals( asset_id, part, block, hash ) )
+		{
+			block.pointsHash = 0;
+			changed = true;
+			return false;
+		}
+
+		changed = hash != block.pointsHash;
+		block.pointsHash = hash;
+		return true;
+	}
+
+	// deformed parts keep their current positions only in the mesh, copy them back before the mesh is rebuilt.
+	// the block keeps its points array the whole time, so this skips a copy per frame but not the memory
+	static void ReadBackPoints( const Mesh& mesh, const std::vector<CookPart>& parts, GeometryCache& cache )
+	{
+		for ( size_t i = 0; i < parts.size(); ++i )
+		{
+			PartBlock* block = cache.find(parts[i].key);
+			if ( !block || !block->pointsInMesh )
+				continue;
+
+			block->pointsInMesh = false;
+			if ( parts[i].dirty || block->vertOfs + block->numPoints() > mesh.getNumVerts() )
+				continue;
+			memcpy( &block->points.front(), &mesh.verts[block->vertOfs], block->points.size() * sizeof(float) );
+		}
+	}
+
+	// first pass: query every visible display part, dirty parts have to be fetched again
+	static void GatherCookParts( HAPI_AssetId asset_id, HAPI_ObjectInfo* oinfo, int objectCount, bool forceUpdate, GeometryCache& cache, std::vector<CookPart>& parts )
+	{
+		for ( int obj = 0; obj < objectCount; obj ++ )
+		{
+			if ( !oinfo[obj].isVisible || !oinfo[obj].geoCount )
+				continue;
 
-			if (!needUpdateGeo)
+			for ( int geo = 0; geo < oinfo[obj].geoCount; geo ++ )
 			{
-				for ( int obj = 0; obj < asset_info.objectCount; obj ++ )
+				HAPI_GeoInfo geoinfo;
+				HAPI_GetGeoInfo(hapi::Engine::instance()->session(), asset_id, oinfo[obj].id, geo, &geoinfo);
+
+				if ( !geoinfo.isDisplayGeo )
+					continue;
+
+				for ( int part = 0; part < geoinfo.partCount; ++part )
 				{
-					if ( oinfo[obj].isVisible && oinfo[obj].geoCount )
-					{
-						for ( int geo = 0; geo < oinfo[obj].geoCount; geo ++ )
-						{
-							HAPI_GeoInfo geoinfo;
-							HAPI_GetGeoInfo(hapi::Engine::instance()->session(), myAssetId, oinfo[obj].id, geo, &geoinfo);
+					CookPart cp;
+					cp.key = PartKey(oinfo[obj].id, geo, part);
+					cp.pointsOnly = false;
+					cp.groupCount = geoinfo.primitiveGroupCount;
 
-							if ( geoinfo.isDisplayGeo && geoinfo.hasGeoChanged )
-							{
-								needUpdateGeo = true;
-								break;
-							}
-						}
-					}
+					if ( HAPI_GetPartInfo(hapi::Engine::instance()->session(), asset_id, cp.key.object, geo, part, &cp.info) != HAPI_RESULT_SUCCESS )
+						continue;
+					if ( cp.info.type != HAPI_PARTTYPE_MESH || !cp.info.faceCount || !cp.info.pointCount )
+						continue;
+
+					PartBlock* block = cache.find(cp.key);
+					cp.dirty = forceUpdate || geoinfo.hasGeoChanged || !block || block->fingerprint != GetPartFingerprint(cp.info);
+
+					parts.push_back(cp);
 				}
 			}
+		}
+	}
+
+	// fetch the raw data of a part from HAPI, must run on the main thread.
+	// P goes straight into block.points, unconverted, everything else into src.
+	// the rest of the block is left as it is
+	static void FetchCookPart( HAPI_AssetId asset_id, const CookPart& part, PartTopology& topo, PartSource& src, PartBlock& block )
+	{
+		HAPI_ObjectId objectId = part.key.object;
+		HAPI_GeoId geo = part.key.geo;
+		HAPI_PartId partId = part.key.part;
+		const HAPI_PartInfo& myPartInfo = part.info;
+
+		src.polyCount.swap(topo.polyCount);
+		src.polyConnect.swap(topo.polyConnect);
+
+		HAPI_Bool are_all_the_same;
+		src.materialIds.resize(myPartInfo.faceCount);
+		HAPI_GetMaterialIdsOnFaces(hapi::Engine::instance()->session(),
+			asset_id, objectId, geo, partId,
+			&are_all_the_same,
+			&src.materialIds.front(),
+			0, myPartInfo.faceCount);
+		src.allSameMaterial = are_all_the_same ? true : false;
+
+		// points
+		block.points.resize(myPartInfo.pointCount * 3);
+		FetchPoints( asset_id, part, &block.points.front() );
+
+		// smoothing group and material id
+		{
+			HAPI_AttributeInfo attr_info;
+			attr_info.exists = false;
+			HAPI_GetAttributeInfo(hapi::Engine::instance()->session(),
+					asset_id, objectId, geo, partId,
+					"max_sg",
+					HAPI_ATTROWNER_PRIM,
+					&attr_info
+					);
+
+			if(attr_info.exists)
+			{
+				src.sg.resize(attr_info.count * attr_info.tupleSize);
+				FetchIntAttribute( asset_id, part, "max_sg", attr_info, &src.sg.front() );
+			}
+			HAPI_GetAttributeInfo(hapi::Engine::instance()->session(),
+					asset_id, objectId, geo, partId,
+					"max_mid",
+					HAPI_ATTROWNER_PRIM,
+					&attr_info
+					);
+
+			if(attr_info.exists)
+			{
+				src.mid.resize(attr_info.count * attr_info.tupleSize);
+				FetchIntAttribute( asset_id, part, "max_mid", attr_info, &src.mid.front() );
+			}
+		}
+
+		// primitive groups
+		FetchGroups( asset_id, part, src.groups );
+
+		// normals
+		HAPI_AttributeOwner normalOwner = FetchNormals( asset_id, part, src.normals );
+		if ( normalOwner != HAPI_ATTROWNER_MAX )
+			src.normalOwner = normalOwner == HAPI_ATTROWNER_POINT ? owner_point : owner_vertex;
+
+		// vertex alpha and color, sorted before the uv channels
+		const char* colorNames[2] = { "Alpha", "Cd" };
+		int colorChannels[2] = { MAP_ALPHA, 0 };
+		for ( int i = 0; i < 2; i++ )
+		{
+			src.uvs.push_back(PartUV());
+			if ( !FetchColorAttribute( asset_id, part, colorNames[i], colorChannels[i], src.uvs.back() ) )
+				src.uvs.pop_back();
+		}
 
-			if ( needUpdateGeo )
+		// uv channels
+		std::vector<UVAttribute> attributes;
+		FindUVAttributes( asset_id, part.key, attributes );
+		for ( size_t i = 0; i < attributes.size(); ++i )
+		{
+			std::string uvName = GetUVName(attributes[i].channel, "uv");
+			std::string uvNumberName = GetUVName(attributes[i].channel, "uvNumber");
+
+			HAPI_AttributeInfo attr_info;
+			attr_info.exists = false;
+			HAPI_GetAttributeInfo(hapi::Engine::instance()->session(),
+				asset_id, objectId, geo, partId,
+				uvName.c_str(),
+				attributes[i].owner,
+				&attr_info
+				);
+			if ( !attr_info.exists || !attr_info.count )
+				continue;
+
+			src.uvs.push_back(PartUV());
+			PartUV& uv = src.uvs.back();
+			uv.channel = attributes[i].channel;
+			uv.owner = attributes[i].owner == HAPI_ATTROWNER_POINT ? owner_point : owner_vertex;
+			uv.tupleSize = attr_info.tupleSize;
+			uv.uv.resize(attr_info.count * attr_info.tupleSize);
+			FetchFloatAttribute( asset_id, part, uvName.c_str(), attr_info, &uv.uv.front() );
+
+			if ( attributes[i].hasNumber )
 			{
-				mesh.Init();
-				for ( int obj = 0; obj < asset_info.objectCount; obj ++ )
+				attr_info.exists = false;
+				HAPI_GetAttributeInfo(hapi::Engine::instance()->session(),
+					asset_id, objectId, geo, partId,
+					uvNumberName.c_str(),
+					attributes[i].owner,
+					&attr_info
+					);
+
+				if (attr_info.exists)
 				{
-					if ( oinfo[obj].isVisible && oinfo[obj].geoCount )
-					{
-						for ( int geo = 0; geo < oinfo[obj].geoCount; geo ++ )
-						{
-							HAPI_GeoInfo geoinfo;
-							HAPI_GetGeoInfo(hapi::Engine::instance()->session(), myAssetId, oinfo[obj].id, geo, &geoinfo);
+					uv.uvNumbers.resize(attr_info.count * attr_info.tupleSize);
+					FetchIntAttribute( asset_id, part, uvNumberName.c_str(), attr_info, &uv.uvNumbers.front() );
+				}
+			}
+		}
+	}
 
-							if ( geoinfo.isDisplayGeo )
-							{
-								for ( int part = 0; part < geoinfo.partCount; ++part )
-								{
-									hstat = HAPI_GetPartInfo(hapi::Engine::instance()->session(), myAssetId, oinfo[obj].id, geo, part, &myPartInfo);
-									if ( hstat == HAPI_RESULT_SUCCESS )
-									{
-										if ( myPartInfo.faceCount && myPartInfo.pointCount )
-										{
-											HAPI_Bool are_all_the_same;
-											HAPI_MaterialId* matid = new HAPI_MaterialId[myPartInfo.faceCount];
-											HAPI_GetMaterialIdsOnFaces(hapi::Engine::instance()->session(),
-												asset_id, oinfo[obj].id, geo, part,
-												&are_all_the_same,
-												matid,
-												0, myPartInfo.faceCount);
-
-											int vertOfs = mesh.getNumVerts();
-											mesh.setNumVerts( vertOfs + (int)myPartInfo.pointCount, TRUE );
-											mesh.InvalidateTopologyCache();
-											{
-												HAPI_AttributeInfo attr_info;
-												attr_info.exists = false;
-												Point3* v = new Point3[myPartInfo.pointCount];
-												HAPI_GetAttributeInfo(hapi::Engine::instance()->session(),
-													myAssetId, oinfo[obj].id, geo, part,
-													"P",
-													HAPI_ATTROWNER_POINT,
-													&attr_info
-													);
-												HAPI_GetAttributeFloatData(hapi::Engine::instance()->session(),
-													myAssetId, oinfo[obj].id, geo, part,
-													"P",
-													&attr_info,
-													(float*)&v[0],
-													0, attr_info.count
-													);
-
-												for ( int i = 0; i < myPartInfo.pointCount; ++i )
-												{
-													float y = v[i].y;
-													v[i].y = -v[i].z;
-													v[i].z = y;
-													v[i] *= scl;
-													mesh.verts[i+vertOfs] = v[i];
-												}
-												delete [] v;
-											}
-											std::vector<int> polyCount;
-											std::vector<int> polyConnect;
-											std::vector<int> sg;
-											std::vector<int> mid;
-											// polygon counts
-											{
-												polyCount.resize(myPartInfo.faceCount);
-
-												if(myPartInfo.faceCount)
-												{
-													HAPI_GetFaceCounts(hapi::Engine::instance()->session(),
-														myAssetId, oinfo[obj].id, geo, part,
-														&polyCount.front(),
-														0,
-														myPartInfo.faceCount
-														);
-
-													HAPI_AttributeInfo attr_info;
-													attr_info.exists = false;
-													HAPI_GetAttributeInfo(hapi::Engine::instance()->session(),
-															myAssetId, oinfo[obj].id, geo, part,
-															"max_sg",
-															HAPI_ATTROWNER_PRIM,
-															&attr_info
-															);
-
-													if(attr_info.exists)
-													{
-														sg.resize(attr_info.count * attr_info.tupleSize);
-														HAPI_GetAttributeIntData(hapi::Engine::instance()->session(),
-																myAssetId, oinfo[obj].id, geo, part,
-																"max_sg",
-																&attr_info,
-																&sg.front(),
-																0,
-																attr_info.count
-																);
-													}
-													HAPI_GetAttributeInfo(hapi::Engine::instance()->session(),
-															myAssetId, oinfo[obj].id, geo, part,
-															"max_mid",
-															HAPI_ATTROWNER_PRIM,
-															&attr_info
-															);
-
-													if(attr_info.exists)
-													{
-														mid.resize(attr_info.count * attr_info.tupleSize);
-														HAPI_GetAttributeIntData(hapi::Engine::instance()->session(),
-																myAssetId, oinfo[obj].id, geo, part,
-																"max_mid",
-																&attr_info,
-																&mid.front(),
-																0,
-																attr_info.count
-																);
-													}
-												}
-											}
-											// polygon connects
-											{
-												polyConnect.resize(myPartInfo.vertexCount);
-
-												if(myPartInfo.vertexCount)
-												{
-													HAPI_GetVertexList(hapi::Engine::instance()->session(),
-														myAssetId, oinfo[obj].id, geo, part,
-														&polyConnect.front(),
-														0,
-														myPartInfo.vertexCount
-														);
-												}
-											}
-											int faces = 0;
-											{for ( int i = 0; i < myPartInfo.faceCount; ++i )
-											{
-												faces += polyCount[i] - 2;
-											}}
-											int faceOfs = mesh.getNumFaces();
-											mesh.setNumFaces( faceOfs+faces, TRUE );
-											mesh.InvalidateTopologyCache();
-
-											int currentVtxIndex = 0;
-											bool found_sg = sg.size() ? true : false;
-											bool found_mid = mid.size() ? true : false;
-											int face = faceOfs;
-											for ( int i = 0; i < myPartInfo.faceCount; ++i )
-											{
-												int numPointsInFace = polyCount[i];
-												for ( size_t j = 0; j < (numPointsInFace-2); j ++ )
-												{
-													mesh.faces[face].setVerts(
-														polyConnect[currentVtxIndex] + vertOfs,
-														polyConnect[currentVtxIndex+j+2] + vertOfs,
-														polyConnect[currentVtxIndex+j+1] + vertOfs );
-													if ( found_sg )
-														mesh.faces[face].setSmGroup(sg[i]);
-													else
-														mesh.faces[face].setSmGroup(1);
-
-													if ( found_mid )
-														mesh.faces[face].setMatID((MtlID)mid[i]);
-													else
-													{
-														if ( are_all_the_same )
-															mesh.faces[face].setMatID(1);
-														else
-															mesh.faces[face].setMatID(matid[i]);
-													}
-
-													if ( numPointsInFace == 3 )
-														mesh.faces[face].setEdgeVisFlags(1,1,1);
-													else if ( j == 0 )
-														mesh.faces[face].setEdgeVisFlags(0,1,1);
-													else if ( j == (numPointsInFace-3) ) 
-														mesh.faces[face].setEdgeVisFlags(1,1,0);
-													else
-														mesh.faces[face].setEdgeVisFlags(0,1,0);
-													face ++;
-												}
-												currentVtxIndex += numPointsInFace;
-											}
+	// a map channel of the assembled mesh, parts without it get one empty tvert
+	struct MapLayout
+	{
+		int					channel;
+		int					numTVerts;
+		std::vector<int>	partMap;	// index into block.maps, -1 if the part does not have the channel
+		std::vector<int>	tvertOfs;
 
-											// uv
-											{
-												HAPI_AttributeOwner owner = HAPI_ATTROWNER_MAX;
-
-												// sill working multi uv support
-												//for (int i = 1; i < MAX_MESHMAPS; ++i)
-												for (int i = 1; i < 2; ++i)
-												{
-													std::string uvName;
-													std::string uvNumberName;
-													uvName = i == 1 ? std::string("uv") : std::string("uv") + std::to_string(i);
-													uvNumberName = i == 1 ? std::string("uvNumber") : std::string("uvNumber") + std::to_string(i);
-
-													int tvertOfs = mesh.getNumTVerts();
-													int uvSize = 0;
-													std::vector<float> uv;
-
-													HAPI_AttributeOwner owner = HAPI_ATTROWNER_MAX;
-													for (int i = 0; i < 2; i++)
-													{
-														// Point or Vertex
-														HAPI_AttributeOwner data_type = i == 0 ? HAPI_ATTROWNER_POINT : HAPI_ATTROWNER_VERTEX;
-														HAPI_AttributeInfo attr_info;
-														attr_info.exists = false;
-														HAPI_GetAttributeInfo(hapi::Engine::instance()->session(),
-															myAssetId, oinfo[obj].id, geo, part,
-															uvName.c_str(),
-															data_type,
-															&attr_info
-															);
-
-														if (attr_info.exists)
-														{
-															uvSize = attr_info.count;
-															uv.resize(attr_info.count * attr_info.tupleSize);
-															HAPI_GetAttributeFloatData(hapi::Engine::instance()->session(),
-																myAssetId, oinfo[obj].id, geo, part,
-																uvName.c_str(),
-																&attr_info,
-																(float*)&uv.front(),
-																0, attr_info.count
-																);
-
-															owner = data_type;
-															break;
-														}
-													}
-
-
-													std::vector<int> uvNumbers;
-
-													if (owner != HAPI_ATTROWNER_MAX)
-													{
-														bool useUVNumber = false;
-														HAPI_AttributeInfo attr_info;
-														attr_info.exists = false;
-														HAPI_GetAttributeInfo(hapi::Engine::instance()->session(),
-															myAssetId, oinfo[obj].id, geo, part,
-															uvNumberName.c_str(),
-															owner,
-															&attr_info
-															);
-
-														if (attr_info.exists)
-														{
-															uvNumbers.resize(attr_info.count);
-															HAPI_GetAttributeIntData(hapi::Engine::instance()->session(),
-																myAssetId, oinfo[obj].id, geo, part,
-																uvNumberName.c_str(),
-																&attr_info,
-																&uvNumbers.front(),
-																0, attr_info.count
-																);
-														}
-													}
-
-													std::vector<int> vertexList(polyConnect.size());
-													std::vector<float> uArray(polyConnect.size());
-													std::vector<float> vArray(polyConnect.size());
-
-													if (owner == HAPI_ATTROWNER_VERTEX && uvNumbers.size())
-													{
-
-														// attempt to restore the shared UVs
-
-														// uvNumber -> uvIndex
-														std::map<int, int> uvNumberMap;
-														// uvIndex -> alternate uvIndex
-														std::vector<int> uvAlternateIndexMap(
-															polyConnect.size(),
-															-1
-															);
-
-														int uvCount = 0;
-														for (unsigned int i = 0; i < polyConnect.size(); ++i)
-														{
-															int uvNumber = uvNumbers[i];
-															float u = uv[i * 3 + 0];
-															float v = uv[i * 3 + 1];
-
-															std::map<int, int>::iterator iter
-																= uvNumberMap.find(uvNumber);
-
-															int lastMappedUVIndex = -1;
-															int mappedUVIndex = -1;
-															if (iter != uvNumberMap.end())
-															{
-																int currMappedUVIndex = iter->second;
-																while (currMappedUVIndex != -1)
-																{
-																	// check that the UV coordinates are the same
-																	if (u == uArray[currMappedUVIndex]
-																		&& v == vArray[currMappedUVIndex])
-																	{
-																		mappedUVIndex = currMappedUVIndex;
-																		break;
-																	}
-
-																	lastMappedUVIndex = currMappedUVIndex;
-																	currMappedUVIndex = uvAlternateIndexMap[currMappedUVIndex];
-																}
-															}
-
-															if (mappedUVIndex == -1)
-															{
-																mappedUVIndex = uvCount;
-																uvCount++;
-
-																uArray[mappedUVIndex] = u;
-																vArray[mappedUVIndex] = v;
-
-																if (lastMappedUVIndex != -1)
-																{
-																	uvAlternateIndexMap[lastMappedUVIndex] = mappedUVIndex;
-																}
-																else
-																{
-																	uvNumberMap[uvNumber] = mappedUVIndex;
-																}
-															}
-
-															vertexList[i] = mappedUVIndex;
-														}
-
-														uArray.resize(uvCount);
-														vArray.resize(uvCount);
-														mesh.setNumTVerts(tvertOfs + uvCount, TRUE);
-														for (int v = 0; v < uvCount; v++)
-														{
-															mesh.tVerts[tvertOfs + v] = Point3(uArray[v], vArray[v], 0.f);
-														}
-
-														if (SetNumTVFaces(mesh, faceOfs, faceOfs + faces))
-														{
-															int currentVtxIndex = 0;
-															int face = faceOfs;
-															for (int i = 0; i < myPartInfo.faceCount; ++i)
-															{
-																int numPointsInFace = polyCount[i];
-																for (int j = 0; j < (numPointsInFace - 2); j++)
-																{
-																	mesh.tvFace[face].setTVerts(
-																		vertexList[currentVtxIndex] + tvertOfs,
-																		vertexList[currentVtxIndex + j + 2] + tvertOfs,
-																		vertexList[currentVtxIndex + j + 1] + tvertOfs);
-
-																	face++;
-																}
-																currentVtxIndex += numPointsInFace;
-															}
-														}
-													}
-													else
-													{
-														if (!uv.size())
-														{
-															// add dummy UV 
-															uv.push_back(0.f);
-															uv.push_back(0.f);
-															uv.push_back(0.f);
-															uvSize = 1;
-														}
-
-														if (uv.size())
-														{
-															mesh.setNumTVerts(tvertOfs + uvSize, TRUE);
-															for (int v = 0; v < uvSize; v++)
-															{
-																mesh.tVerts[tvertOfs + v] = Point3( uv[v*3+0], uv[v * 3 + 1], 0.f);
-															}
-
-															if (SetNumTVFaces(mesh, faceOfs, faceOfs + faces))
-															{
-																int currentVtxIndex = 0;
-																int face = faceOfs;
-																if (uvSize == 1)
-																{
-																	// set to empty uvs
-																	for (int i = 0; i < myPartInfo.faceCount; ++i)
-																	{
-																		int numPointsInFace = polyCount[i];
-																		for (int j = 0; j < (numPointsInFace - 2); j++)
-																		{
-																			mesh.tvFace[face].setTVerts(
-																				tvertOfs,
-																				tvertOfs,
-																				tvertOfs);
-
-																			face++;
-																		}
-																	}
-																}
-																else
-																{
-																	for (int i = 0; i < myPartInfo.faceCount; ++i)
-																	{
-																		int numPointsInFace = polyCount[i];
-																		for (int j = 0; j < (numPointsInFace - 2); j++)
-																		{
-																			switch (owner)
-																			{
-																			case HAPI_ATTROWNER_POINT:
-																				mesh.tvFace[face].setTVerts(
-																					polyConnect[currentVtxIndex] + tvertOfs,
-																					polyConnect[currentVtxIndex + j + 2] + tvertOfs,
-																					polyConnect[currentVtxIndex + j + 1] + tvertOfs);
-																				break;
-																			case HAPI_ATTROWNER_VERTEX:
-																				mesh.tvFace[face].setTVerts(
-																					currentVtxIndex + tvertOfs,
-																					currentVtxIndex + j + 2 + tvertOfs,
-																					currentVtxIndex + j + 1 + tvertOfs);
-																				break;
-																			}
-
-																			face++;
-																		}
-																		currentVtxIndex += numPointsInFace;
-																	}
-																}
-															}
-														}
-													}
-												}
-											}
-											delete[] matid;
-										}
-									}
-								}
-							}
+		// white for color and alpha, 0 for uvs
+		UVVert emptyTVert() const { return channel < 1 ? UVVert(1.f, 1.f, 1.f) : UVVert(0.f, 0.f, 0.f); }
+	};
+
+	static void GetMapLayout( const std::vector<PartBlock*>& blocks, std::vector<MapLayout>& layouts )
+	{
+		// hidden channels (alpha) are negative
+		bool used[NUM_HIDDENMAPS + MAX_MESHMAPS] = { false };
+		for ( size_t i = 0; i < blocks.size(); ++i )
+		{
+			for ( size_t m = 0; m < blocks[i]->maps.size(); ++m )
+				used[NUM_HIDDENMAPS + blocks[i]->maps[m].channel] = true;
+		}
+
+		for ( int ch = -NUM_HIDDENMAPS; ch < MAX_MESHMAPS; ++ch )
+		{
+			if ( !used[NUM_HIDDENMAPS + ch] )
+				continue;
+
+			MapLayout layout;
+			layout.channel = ch;
+			layout.numTVerts = 0;
+			layout.partMap.resize(blocks.size(), -1);
+			layout.tvertOfs.resize(blocks.size());
+			for ( size_t i = 0; i < blocks.size(); ++i )
+			{
+				const std::vector<PartMap>& maps = blocks[i]->maps;
+				for ( size_t m = 0; m < maps.size(); ++m )
+				{
+					if ( maps[m].channel == ch )
+						layout.partMap[i] = (int)m;
+				}
+				layout.tvertOfs[i] = layout.numTVerts;
+				layout.numTVerts += layout.partMap[i] >= 0 ? maps[layout.partMap[i]].numTVerts() : 1;
+			}
+			layouts.push_back(layout);
+		}
+	}
+
+	// second pass: allocate once and copy every cached part into its own range
+	static void AssembleMesh( Mesh& mesh, const std::vector<CookPart>& parts, GeometryCache& cache )
+	{
+		int numVerts = 0;
+		int numFaces = 0;
+		int numNormals = 0;
+		std::vector<PartBlock*> blocks(parts.size());
+		std::vector<int> faceOfs(parts.size());
+		for ( size_t i = 0; i < parts.size(); ++i )
+		{
+			blocks[i] = cache.find(parts[i].key);
+			blocks[i]->vertOfs = numVerts;
+			blocks[i]->faceOfs = numFaces;
+			blocks[i]->normalOfs = numNormals;
+			faceOfs[i] = numFaces;
+			numVerts   += blocks[i]->numPoints();
+			numFaces   += blocks[i]->numFaces();
+			numNormals += blocks[i]->numNormals();
+		}
+		std::vector<MapLayout> layouts;
+		GetMapLayout( blocks, layouts );
+
+		mesh.Init();
+		mesh.setNumVerts( numVerts );
+		mesh.setNumFaces( numFaces );
+		// drop channels of an earlier cook
+		mesh.setNumMaps( layouts.size() ? std::max(layouts.back().channel + 1, 2) : 2 );
+		for ( int ch = -NUM_HIDDENMAPS; ch < mesh.getNumMaps(); ++ch )
+			mesh.setMapSupport( ch, FALSE );
+		for ( size_t l = 0; l < layouts.size(); ++l )
+		{
+			int ch = layouts[l].channel;
+			mesh.setMapSupport( ch, TRUE );
+			mesh.setNumMapVerts( ch, layouts[l].numTVerts );
+			mesh.setNumMapFaces( ch, numFaces );
+		}
+
+		// cooked N become explicit normals, faces of parts without N are left to max
+		MeshNormalSpec* normalSpec = NULL;
+		if ( numNormals )
+		{
+			mesh.SpecifyNormals();
+			normalSpec = mesh.GetSpecifiedNormals();
+			normalSpec->ClearAndFree();
+			normalSpec->SetParent( &mesh );
+			normalSpec->SetNumFaces( numFaces );
+			normalSpec->SetNumNormals( numNormals );
+		}
+		else
+			mesh.ClearSpecifiedNormals();
+
+		// ranges do not overlap, parts and their map channels are copied in parallel
+		int numParts = (int)blocks.size();
+		ParallelFor( numParts * (int)(layouts.size() + 1), [&]( int task )
+		{
+			int i = task % numParts;
+			int l = task / numParts - 1;
+			const PartBlock& block = *blocks[i];
+			int vOfs = block.vertOfs;
+			int fOfs = faceOfs[i];
+
+			if ( l < 0 )
+			{
+				for ( int v = 0; v < block.numPoints(); ++v )
+				{
+					mesh.verts[vOfs + v] = Point3(block.points[v*3+0], block.points[v*3+1], block.points[v*3+2]);
+				}
+				for ( int f = 0; f < block.numFaces(); ++f )
+				{
+					Face& face = mesh.faces[fOfs + f];
+					unsigned char vis = block.edgeVis[f];
+					face.setVerts(
+						block.faces[f*3+0] + vOfs,
+						block.faces[f*3+1] + vOfs,
+						block.faces[f*3+2] + vOfs );
+					face.setSmGroup(block.smGroups[f]);
+					face.setMatID((MtlID)block.matIds[f]);
+					face.setEdgeVisFlags(vis & 1, (vis >> 1) & 1, (vis >> 2) & 1);
+				}
+				if ( normalSpec )
+				{
+					int nOfs = block.normalOfs;
+					for ( int n = 0; n < block.numNormals(); ++n )
+					{
+						normalSpec->Normal(nOfs + n) = Point3(block.normals[n*3+0], block.normals[n*3+1], block.normals[n*3+2]);
+					}
+					for ( int f = 0; f < block.numFaces(); ++f )
+					{
+						MeshNormalFace& nf = normalSpec->Face(fOfs + f);
+						if ( block.normals.empty() )
+						{
+							nf.SpecifyAll(false);
+							continue;
 						}
+						nf.SpecifyAll();
+						for ( int k = 0; k < 3; ++k )
+							nf.SetNormalID(k, block.normalFaces[f*3+k] + nOfs);
 					}
 				}
+				return;
 			}
-			mesh.InvalidateTopologyCache();
-			//mesh.InvalidateGeomCache();
-			delete [] oinfo;
+
+			const MapLayout& layout = layouts[l];
+			int tOfs = layout.tvertOfs[i];
+			UVVert* tv = mesh.mapVerts( layout.channel );
+			TVFace* tf = mesh.mapFaces( layout.channel );
+			if ( layout.partMap[i] < 0 )
+			{
+				tv[tOfs] = layout.emptyTVert();
+				for ( int f = 0; f < block.numFaces(); ++f )
+					tf[fOfs + f].setTVerts( tOfs, tOfs, tOfs );
+				return;
+			}
+
+			const PartMap& map = block.maps[layout.partMap[i]];
+			for ( int f = 0; f < block.numFaces(); ++f )
+			{
+				tf[fOfs + f].setTVerts(
+					map.tvFaces[f*3+0] + tOfs,
+					map.tvFaces[f*3+1] + tOfs,
+					map.tvFaces[f*3+2] + tOfs );
+			}
+			memcpy( (float*)&tv[tOfs], &map.tverts.front(), map.tverts.size() * sizeof(float) );
+		} );
+
+		if ( normalSpec )
+		{
+			normalSpec->SetAllExplicit();
+			normalSpec->CheckNormals();
+		}
+	}
+
+	// polygon mode: same as AssembleMesh but into an MNMesh, the tri mesh is derived from it.
+	// SimpleObject2 draws, hit tests and bounds from the tri mesh, so it is always built and this
+	// mode holds the poly blocks, the MNMesh and the tri mesh at once. it uses more memory than
+	// triangle mode, what it saves is the rebuild of the polygons when the result is edited as poly
+	static void AssemblePoly( MNMesh& mm, Mesh& mesh, const std::vector<CookPart>& parts, GeometryCache& cache )
+	{
+		int numVerts = 0;
+		int numPolys = 0;
+		int numNormals = 0;
+		std::vector<PartBlock*> blocks(parts.size());
+		std::vector<int> polyOfs(parts.size());
+		for ( size_t i = 0; i < parts.size(); ++i )
+		{
+			blocks[i] = cache.find(parts[i].key);
+			blocks[i]->vertOfs = numVerts;
+			blocks[i]->faceOfs = numPolys;
+			blocks[i]->normalOfs = numNormals;
+			polyOfs[i] = numPolys;
+			numVerts   += blocks[i]->numPoints();
+			numPolys   += blocks[i]->numPolys();
+			numNormals += blocks[i]->numNormals();
+		}
+		std::vector<MapLayout> layouts;
+		GetMapLayout( blocks, layouts );
+
+		mm.ClearAndFree();
+		mm.setNumVerts( numVerts );
+		mm.setNumFaces( numPolys );
+		mm.SetMapNum( layouts.size() ? std::max(layouts.back().channel + 1, 2) : 2 );
+		for ( int ch = -NUM_HIDDENMAPS; ch < mm.MNum(); ++ch )
+			mm.M(ch)->SetFlag( MN_DEAD );
+
+		// MakePoly allocates per face, stays on this thread
+		std::vector<int> vv;
+		for ( size_t i = 0; i < blocks.size(); ++i )
+		{
+			PartBlock& block = *blocks[i];
+			int vertOfs = block.vertOfs;
+
+			for ( int v = 0; v < block.numPoints(); ++v )
+			{
+				mm.v[vertOfs + v].p = Point3(block.points[v*3+0], block.points[v*3+1], block.points[v*3+2]);
+			}
+			int corner = 0;
+			for ( int f = 0; f < block.numPolys(); ++f )
+			{
+				int deg = block.polyDegrees[f];
+				vv.resize(deg);
+				for ( int j = 0; j < deg; ++j )
+					vv[j] = block.polyVerts[corner + j] + vertOfs;
+
+				MNFace& face = mm.f[polyOfs[i] + f];
+				face.MakePoly(deg, &vv.front());
+				face.smGroup = block.smGroups[f];
+				face.material = (MtlID)block.matIds[f];
+				corner += deg;
+			}
+		}
+
+		for ( size_t l = 0; l < layouts.size(); ++l )
+		{
+			const MapLayout& layout = layouts[l];
+			MNMap* map = mm.M(layout.channel);
+			map->ClearFlag( MN_DEAD );
+			map->setNumVerts( layout.numTVerts );
+			map->setNumFaces( numPolys );
+
+			for ( size_t i = 0; i < blocks.size(); ++i )
+			{
+				const PartBlock& block = *blocks[i];
+				int tOfs = layout.tvertOfs[i];
+				const PartMap* pmap = layout.partMap[i] >= 0 ? &block.maps[layout.partMap[i]] : NULL;
+				if ( !pmap )
+					map->V(tOfs) = layout.emptyTVert();
+				else
+				{
+					for ( int v = 0; v < pmap->numTVerts(); ++v )
+						map->V(tOfs + v) = UVVert(pmap->tverts[v*3+0], pmap->tverts[v*3+1], pmap->tverts[v*3+2]);
+				}
+
+				int corner = 0;
+				for ( int f = 0; f < block.numPolys(); ++f )
+				{
+					int deg = block.polyDegrees[f];
+					vv.resize(deg);
+					for ( int j = 0; j < deg; ++j )
+						vv[j] = (pmap ? pmap->polyTVerts[corner + j] : 0) + tOfs;
+					map->F(polyOfs[i] + f)->MakePoly(deg, &vv.front());
+					corner += deg;
+				}
+			}
+		}
+
+		if ( numNormals )
+		{
+			mm.SpecifyNormals();
+			MNNormalSpec* normalSpec = mm.GetSpecifiedNormals();
+			normalSpec->SetParent( &mm );
+			normalSpec->SetNumFaces( numPolys );
+			normalSpec->SetNumNormals( numNormals );
+			for ( size_t i = 0; i < blocks.size(); ++i )
+			{
+				const PartBlock& block = *blocks[i];
+				int nOfs = block.normalOfs;
+				for ( int n = 0; n < block.numNormals(); ++n )
+				{
+					normalSpec->Normal(nOfs + n) = Point3(block.normals[n*3+0], block.normals[n*3+1], block.normals[n*3+2]);
+				}
+
+				int corner = 0;
+				for ( int f = 0; f < block.numPolys(); ++f )
+				{
+					int deg = block.polyDegrees[f];
+					MNNormalFace& nf = normalSpec->Face(polyOfs[i] + f);
+					nf.SetDegree(deg);
+					if ( block.normals.size() )
+					{
+						nf.SpecifyAll();
+						for ( int j = 0; j < deg; ++j )
+							nf.SetNormalID(j, block.polyNormals[corner + j] + nOfs);
+					}
+					else
+						nf.SpecifyAll(false);
+					corner += deg;
+				}
+			}
+			normalSpec->SetAllExplicit();
+			normalSpec->CheckNormals();
+		}
+		else
+			mm.ClearSpecifiedNormals();
+
+		mm.InvalidateTopoCache();
+		mm.FillInMesh();
+		mm.OutToTri( mesh );
+	}
+
+	bool BuildMeshFromCookResult( Mesh& mesh, GeometryCache& cache, HAPI_AssetId asset_id, float scl, bool forceUpdate, bool deformOnly, MNMesh* polyMesh, HAPI_ObjectId object_id )
+	{
+		HAPI_AssetId myAssetId( asset_id );
+		HAPI_AssetInfo asset_info;
+		bool meshChanged = false;
+
+		HAPI_GetAssetInfo(hapi::Engine::instance()->session(), myAssetId, &asset_info);
+		if ( asset_info.objectCount )
+		{
+			HAPI_ObjectInfo* oinfo = new HAPI_ObjectInfo[ asset_info.objectCount ];
+			HAPI_GetObjects(hapi::Engine::instance()->session(), myAssetId, oinfo, 0, asset_info.objectCount);
+
+			// only one object, it is built even if houdini hides it
+			HAPI_ObjectInfo* objects = oinfo;
+			int objectCount = asset_info.objectCount;
+			if ( object_id >= 0 )
+			{
+				objects = std::find_if( oinfo, oinfo + objectCount, [&]( const HAPI_ObjectInfo& info ) { return info.id == object_id; } );
+				objectCount = objects != oinfo + objectCount ? 1 : 0;
+				if ( objectCount )
+					objects->isVisible = true;
+			}
+
+			// a forced update fetches every part again, but parts whose content hash
+			// did not change are not converted again
+			std::vector<CookPart> parts;
+			GatherCookParts( myAssetId, objects, objectCount, forceUpdate, cache, parts );
+
+			// parts that disappeared also require a new mesh
+			bool needUpdateGeo = forceUpdate || parts.size() != cache.size();
+			meshChanged = needUpdateGeo;
+			std::vector<PartKey> keys(parts.size());
+			for ( size_t i = 0; i < parts.size(); ++i )
+			{
+				keys[i] = parts[i].key;
+				needUpdateGeo = needUpdateGeo || parts[i].dirty;
+			}
+
+			// deformation only: a dirty part whose counts and connectivity did not
+			// change only needs its positions fetched again
+			std::vector<PartTopology> topos(parts.size());
+			bool pointsOnly = needUpdateGeo && deformOnly && !forceUpdate;
+			for ( size_t i = 0; i < parts.size(); ++i )
+			{
+				if ( !parts[i].dirty )
+					continue;
+
+				FetchTopology( myAssetId, parts[i], topos[i] );
+				PartBlock* block = cache.find(parts[i].key);
+				parts[i].pointsOnly = deformOnly && !forceUpdate && block && !block->released &&
+					block->fingerprint == GetPartFingerprint(parts[i].info) &&
+					block->topologyHash == TopologyHash(topos[i]);
+				pointsOnly = pointsOnly && parts[i].pointsOnly;
+			}
+			if ( pointsOnly )
+			{
+				int numVerts = 0;
+				for ( size_t i = 0; i < parts.size(); ++i )
+					numVerts += cache.find(parts[i].key)->fingerprint.pointCount;
+				pointsOnly = parts.size() == cache.size() && numVerts == mesh.getNumVerts();
+			}
+
+			if ( pointsOnly )
+			{
+				// write positions straight into the existing mesh, the block is only synced
+				// when the mesh has to be rebuilt
+				for ( size_t i = 0; i < parts.size(); ++i )
+				{
+					if ( !parts[i].dirty )
+						continue;
+
+					PartBlock& block = *cache.find(parts[i].key);
+					block.pointsInMesh = true;
+					bool changed;
+					if ( !RefreshPartPoints( myAssetId, parts[i], scl, block, (float*)&mesh.verts[block.vertOfs], changed ) )
+					{
+						// N changed its count, rebuild like a topology change
+						parts[i].pointsOnly = false;
+						pointsOnly = false;
+						break;
+					}
+					if ( !changed )
+						continue;
+
+					meshChanged = true;
+					if ( polyMesh )
+					{
+						for ( int v = 0; v < block.numPoints(); ++v )
+							polyMesh->v[block.vertOfs + v].p = mesh.verts[block.vertOfs + v];
+					}
+
+					// normals follow the deformation
+					if ( block.normals.size() )
+					{
+						MeshNormalSpec* normalSpec = mesh.GetSpecifiedNormals();
+						MNNormalSpec* polyNormalSpec = polyMesh ? polyMesh->GetSpecifiedNormals() : NULL;
+						for ( int n = 0; n < block.numNormals(); ++n )
+						{
+							Point3 normal(block.normals[n*3+0], block.normals[n*3+1], block.normals[n*3+2]);
+							if ( normalSpec )
+								normalSpec->Normal(block.normalOfs + n) = normal;
+							if ( polyNormalSpec )
+								polyNormalSpec->Normal(block.normalOfs + n) = normal;
+						}
+					}
+				}
+				if ( meshChanged )
+				{
+					mesh.InvalidateGeomCache();
+					if ( polyMesh )
+						polyMesh->InvalidateGeomCache();
+				}
+			}
+			if ( !pointsOnly && needUpdateGeo )
+			{
+				ReadBackPoints( mesh, parts, cache );
+				bool sortByMaterial = GetSortByMaterial();
+				int chunk = GetFetchChunkSize();
+
+				// released parts are only in the old mesh, they are fetched again like a changed part
+				for ( size_t i = 0; i < parts.size(); ++i )
+				{
+					PartBlock* block = cache.find(parts[i].key);
+					if ( parts[i].dirty || !block || !block->released )
+						continue;
+					FetchTopology( myAssetId, parts[i], topos[i] );
+					parts[i].dirty = true;
+				}
+
+				// HAPI is not thread safe, fetch every changed part first. P of a rebuilt part goes
+				// into its block and AssembleMesh copies it into the mesh, only deformation-only
+				// cooks write P straight into the mesh
+				std::vector<PartSource> sources(parts.size());
+				std::vector<const PartSource*> convertSources;
+				std::vector<PartBlock*> convertBlocks;
+				for ( size_t i = 0; i < parts.size(); ++i )
+				{
+					if ( !parts[i].dirty )
+						continue;
+
+					PartBlock& block = cache.get(parts[i].key);
+					if ( parts[i].pointsOnly )
+					{
+						bool changed;
+						bool refreshed = RefreshPartPoints( myAssetId, parts[i], scl, block, &block.points.front(), changed );
+						meshChanged = meshChanged || changed;
+						if ( refreshed )
+							continue;
+						// N changed its count, fetched and converted again below
+					}
+
+					uint64_t topologyHash = TopologyHash(topos[i]);
+					FetchCookPart( myAssetId, parts[i], topos[i], sources[i], block );
+					const PartSource& src = sources[i];
+					uint64_t pointsHash = PointsHash( &block.points.front(), parts[i].info.pointCount,
+						src.normals.size() ? &src.normals.front() : NULL, (int)(src.normals.size() / 3), scl );
+					uint64_t contentHash = HashPartSource( src, (polyMesh ? 1 : 0) | (sortByMaterial ? 2 : 0) );
+
+					// same result as last time, only the fetched points need converting again
+					bool converted = !block.released && (block.faces.size() || block.polyDegrees.size());
+					if ( converted && pointsHash == block.pointsHash && contentHash == block.contentHash &&
+						block.fingerprint == GetPartFingerprint(parts[i].info) )
+					{
+						ConvertPoints( &block.points.front(), block.numPoints(), scl );
+						continue;
+					}
+
+					std::vector<float> points;
+					points.swap( block.points );
+					block.clear();
+					block.points.swap( points );
+					block.fingerprint = GetPartFingerprint(parts[i].info);
+					block.topologyHash = topologyHash;
+					block.pointsHash = pointsHash;
+					block.contentHash = contentHash;
+					convertSources.push_back( &sources[i] );
+					convertBlocks.push_back( &block );
+					meshChanged = true;
+				}
+				cache.retain( keys );
+
+				if ( meshChanged )
+				{
+					// then convert them on worker threads
+					ConvertParts( convertSources, convertBlocks, scl, polyMesh != NULL, sortByMaterial );
+
+					// the raw parts are not needed any more, free them before the max mesh is allocated
+					// so the fetched, converted and assembled copies are never alive at the same time
+					std::vector<PartSource>().swap( sources );
+					std::vector<PartTopology>().swap( topos );
+
+					if ( polyMesh )
+						AssemblePoly( *polyMesh, mesh, parts, cache );
+					else
+						AssembleMesh( mesh, parts, cache );
+					mesh.InvalidateTopologyCache();
+
+					for ( size_t i = 0; i < parts.size(); ++i )
+					{
+						if ( IsLargePart( parts[i].info, chunk ) )
+							cache.find(parts[i].key)->release();
+					}
+				}
+			}
+			delete [] oinfo;
+		}
+		return meshChanged;
+	}
+
+	static bool LessFaceOfs( const PartBlock* a, const PartBlock* b )
+	{
+		return a->faceOfs < b->faceOfs;
+	}
+
+	void GetFaceGroups( const GeometryCache& cache, int numFaces, std::vector<FaceGroup>& groups )
+	{
+		groups.clear();
+
+		// in assembly order, polygon blocks need the triangles of the blocks before them
+		std::vector<const PartBlock*> blocks;
+		cache.getBlocks( blocks );
+		std::sort( blocks.begin(), blocks.end(), LessFaceOfs );
+
+		// released blocks have no faces left, the bits of the groups are walked instead
+		std::map<std::string, size_t> index;
+		int triOfs = 0;
+		for ( size_t i = 0; i < blocks.size(); ++i )
+		{
+			const PartBlock& block = *blocks[i];
+			int firstTri = block.polyDegrees.size() ? triOfs : block.faceOfs;
+			for ( size_t p = 0; p < block.polyDegrees.size(); ++p )
+				triOfs += std::max(block.polyDegrees[p] - 2, 0);
+
+			for ( size_t g = 0; g < block.groups.size(); ++g )
+			{
+				const PartGroup& group = block.groups[g];
+				std::map<std::string, size_t>::iterator it = index.find(group.name);
+				if ( it == index.end() )
+				{
+					it = index.insert(std::make_pair(group.name, groups.size())).first;
+					groups.push_back(FaceGroup());
+					groups.back().name = group.name;
+					groups.back().faces.SetSize(numFaces);
+				}
+
+				BitArray& dst = groups[it->second].faces;
+				if ( block.polyDegrees.size() )
+				{
+					// MNMesh::OutToTri gives every polygon degree - 2 triangles, in polygon order
+					int tri = firstTri;
+					for ( int p = 0; p < block.numPolys(); ++p )
+					{
+						int count = std::max(block.polyDegrees[p] - 2, 0);
+						if ( group.contains(p) )
+						{
+							for ( int k = 0; k < count && tri + k < numFaces; ++k )
+								dst.Set(tri + k);
+						}
+						tri += count;
+					}
+					continue;
+				}
+
+				int faces = std::min((int)group.bits.size() * 32, numFaces - firstTri);
+				for ( int f = 0; f < faces; ++f )
+				{
+					if ( group.contains(f) )
+						dst.Set(firstTri + f);
+				}
+			}
+		}
+	}
+
+	// fetch a point attribute of a part straight into dst, false if it is missing or does not fit
+	static bool FetchPointAttribute( HAPI_AssetId asset_id, const CookPart& part, const char* name, int tupleSize, float* dst )
+	{
+		HAPI_AttributeInfo attr_info;
+		attr_info.exists = false;
+		HAPI_GetAttributeInfo(hapi::Engine::instance()->session(),
+			asset_id, part.key.object, part.key.geo, part.key.part,
+			name,
+			HAPI_ATTROWNER_POINT,
+			&attr_info
+			);
+		if ( !attr_info.exists || attr_info.tupleSize != tupleSize || attr_info.count != part.info.pointCount )
+			return false;
+
+		FetchFloatAttribute( asset_id, part, name, attr_info, dst );
+		return true;
+	}
+
+	static bool FetchPointAttribute( HAPI_AssetId asset_id, const CookPart& part, const char* name, int* dst )
+	{
+		HAPI_AttributeInfo attr_info;
+		attr_info.exists = false;
+		HAPI_GetAttributeInfo(hapi::Engine::instance()->session(),
+			asset_id, part.key.object, part.key.geo, part.key.part,
+			name,
+			HAPI_ATTROWNER_POINT,
+			&attr_info
+			);
+		if ( !attr_info.exists || attr_info.tupleSize != 1 || attr_info.count != part.info.pointCount )
+			return false;
+
+		FetchIntAttribute( asset_id, part, name, attr_info, dst );
+		return true;
+	}
+
+	// visible display parts with points but no faces
+	static bool GatherPointParts( HAPI_AssetId asset_id, HAPI_ObjectInfo* oinfo, int objectCount, std::vector<CookPart>& parts )
+	{
+		bool changed = false;
+		for ( int obj = 0; obj < objectCount; obj ++ )
+		{
+			if ( !oinfo[obj].isVisible || !oinfo[obj].geoCount )
+				continue;
+
+			for ( int geo = 0; geo < oinfo[obj].geoCount; geo ++ )
+			{
+				HAPI_GeoInfo geoinfo;
+				HAPI_GetGeoInfo(hapi::Engine::instance()->session(), asset_id, oinfo[obj].id, geo, &geoinfo);
+
+				if ( !geoinfo.isDisplayGeo )
+					continue;
+
+				for ( int part = 0; part < geoinfo.partCount; ++part )
+				{
+					CookPart cp;
+					cp.key = PartKey(oinfo[obj].id, geo, part);
+					cp.pointsOnly = true;
+					cp.groupCount = 0;
+					cp.dirty = geoinfo.hasGeoChanged ? true : false;
+
+					if ( HAPI_GetPartInfo(hapi::Engine::instance()->session(), asset_id, cp.key.object, geo, part, &cp.info) != HAPI_RESULT_SUCCESS )
+						continue;
+					if ( cp.info.type != HAPI_PARTTYPE_MESH || cp.info.faceCount || !cp.info.pointCount )
+						continue;
+
+					changed = changed || cp.dirty;
+					parts.push_back(cp);
+				}
+			}
+		}
+		return changed;
+	}
+
+	void BuildParticlesFromCookResult( ParticleCloud& cloud, HAPI_AssetId asset_id, float scl, bool forceUpdate )
+	{
+		std::vector<CookPart> parts;
+		bool changed = forceUpdate;
+
+		HAPI_AssetInfo asset_info;
+		HAPI_GetAssetInfo(hapi::Engine::instance()->session(), asset_id, &asset_info);
+		if ( asset_info.objectCount )
+		{
+			std::vector<HAPI_ObjectInfo> oinfo(asset_info.objectCount);
+			HAPI_GetObjects(hapi::Engine::instance()->session(), asset_id, &oinfo.front(), 0, asset_info.objectCount);
+			changed = GatherPointParts( asset_id, &oinfo.front(), asset_info.objectCount, parts ) || changed;
+		}
+
+		int count = 0;
+		for ( size_t i = 0; i < parts.size(); ++i )
+			count += parts[i].info.pointCount;
+		if ( !changed && count == cloud.count() )
+			return;
+
+		// every attribute is read with one call per part straight into its final range
+		cloud.resize(count);
+		int ofs = 0;
+		for ( size_t i = 0; i < parts.size(); ++i )
+		{
+			const CookPart& part = parts[i];
+			int n = part.info.pointCount;
+
+			FetchPoints( asset_id, part, &cloud.positions[ofs * 3] );
+			if ( !FetchPointAttribute( asset_id, part, "v", 3, &cloud.velocities[ofs * 3] ) )
+				std::fill( cloud.velocities.begin() + ofs * 3, cloud.velocities.begin() + (ofs + n) * 3, 0.f );
+			if ( !FetchPointAttribute( asset_id, part, "pscale", 1, &cloud.scales[ofs] ) )
+				std::fill( cloud.scales.begin() + ofs, cloud.scales.begin() + ofs + n, 1.f );
+			if ( !FetchPointAttribute( asset_id, part, "age", 1, &cloud.ages[ofs] ) )
+				std::fill( cloud.ages.begin() + ofs, cloud.ages.begin() + ofs + n, 0.f );
+			if ( !FetchPointAttribute( asset_id, part, "id", &cloud.ids[ofs] ) )
+			{
+				for ( int p = 0; p < n; ++p )
+					cloud.ids[ofs + p] = ofs + p;
+			}
+			ofs += n;
+		}
+
+		if ( count )
+		{
+			// v is a direction in units per second, max wants units per tick
+			ConvertPoints( &cloud.positions.front(), count, scl );
+			ConvertPoints( &cloud.velocities.front(), count, scl / TIME_TICKSPERSEC );
+			for ( int p = 0; p < count; ++p )
+				cloud.scales[p] *= scl;
+		}
+		cloud.updateBounds();
+	}
+
+	// curve counts, orders, knots and cvs of a curve part, one call each
+	static bool FetchCurvePart( HAPI_AssetId asset_id, const CookPart& part, CurveSource& src )
+	{
+		HAPI_CurveInfo curve_info;
+		if ( HAPI_GetCurveInfo(hapi::Engine::instance()->session(),
+				asset_id, part.key.object, part.key.geo, part.key.part,
+				&curve_info) != HAPI_RESULT_SUCCESS )
+			return false;
+		if ( curve_info.curveType == HAPI_CURVETYPE_INVALID || !curve_info.curveCount )
+			return false;
+
+		src.type = (CurveType)curve_info.curveType;
+		src.periodic = curve_info.isPeriodic ? true : false;
+		src.order = curve_info.order;
+
+		src.counts.resize(curve_info.curveCount);
+		HAPI_GetCurveCounts(hapi::Engine::instance()->session(),
+			asset_id, part.key.object, part.key.geo, part.key.part,
+			&src.counts.front(),
+			0, curve_info.curveCount
+			);
+
+		if ( !src.order )
+		{
+			src.orders.resize(curve_info.curveCount);
+			HAPI_GetCurveOrders(hapi::Engine::instance()->session(),
+				asset_id, part.key.object, part.key.geo, part.key.part,
+				&src.orders.front(),
+				0, curve_info.curveCount
+				);
+		}
+
+		if ( curve_info.hasKnots && curve_info.knotCount )
+		{
+			src.knots.resize(curve_info.knotCount);
+			HAPI_GetCurveKnots(hapi::Engine::instance()->session(),
+				asset_id, part.key.object, part.key.geo, part.key.part,
+				&src.knots.front(),
+				0, curve_info.knotCount
+				);
+		}
+
+		src.cvs.resize(part.info.pointCount * 3);
+		if ( part.info.pointCount )
+			FetchPoints( asset_id, part, &src.cvs.front() );
+		return true;
+	}
+
+	static int GetMaxKnotType( CurveKnotType type )
+	{
+		if ( type == knot_corner )
+			return KTYPE_CORNER;
+		else if ( type == knot_bezier )
+			return KTYPE_BEZIER_CORNER;
+		return KTYPE_AUTO;
+	}
+
+	void BuildShapeFromCookResult( BezierShape& shape, HAPI_AssetId asset_id, float scl )
+	{
+		shape.NewShape();
+
+		HAPI_AssetInfo asset_info;
+		HAPI_GetAssetInfo(hapi::Engine::instance()->session(), asset_id, &asset_info);
+		if ( !asset_info.objectCount )
+			return;
+
+		std::vector<HAPI_ObjectInfo> oinfo(asset_info.objectCount);
+		HAPI_GetObjects(hapi::Engine::instance()->session(), asset_id, &oinfo.front(), 0, asset_info.objectCount);
+
+		// HAPI is not thread safe, fetch every curve part first
+		std::vector<CurveSource> sources;
+		for ( size_t obj = 0; obj < oinfo.size(); obj ++ )
+		{
+			if ( !oinfo[obj].isVisible || !oinfo[obj].geoCount )
+				continue;
+
+			for ( int geo = 0; geo < oinfo[obj].geoCount; geo ++ )
+			{
+				HAPI_GeoInfo geoinfo;
+				HAPI_GetGeoInfo(hapi::Engine::instance()->session(), asset_id, oinfo[obj].id, geo, &geoinfo);
+
+				if ( !geoinfo.isDisplayGeo )
+					continue;
+
+				for ( int part = 0; part < geoinfo.partCount; ++part )
+				{
+					CookPart cp;
+					cp.key = PartKey(oinfo[obj].id, geo, part);
+					if ( HAPI_GetPartInfo(hapi::Engine::instance()->session(), asset_id, cp.key.object, geo, part, &cp.info) != HAPI_RESULT_SUCCESS )
+						continue;
+					if ( cp.info.type != HAPI_PARTTYPE_CURVE )
+						continue;
+
+					sources.push_back(CurveSource());
+					if ( !FetchCurvePart( asset_id, cp, sources.back() ) )
+						sources.pop_back();
+				}
+			}
+		}
+
+		// then convert them on worker threads
+		std::vector<CurveBlock> blocks(sources.size());
+		ParallelFor( (int)sources.size(), [&]( int i )
+		{
+			ConvertCurves( sources[i], blocks[i], scl );
+		} );
+
+		// max splines need 2 knots and whole bezier segments, the rest is dropped but not silently
+		int skippedCurves = 0;
+		int droppedCVs = 0;
+		for ( size_t i = 0; i < blocks.size(); ++i )
+		{
+			skippedCurves += blocks[i].skippedCurves;
+			droppedCVs += blocks[i].droppedCVs;
+		}
+		if ( skippedCurves || droppedCVs )
+		{
+			GetCOREInterface()->Log()->LogEntry( SYSLOG_WARN, NO_DIALOG, ::GetString(IDS_CATEGORY),
+				::GetString(IDS_HE_SKIPPED_CURVES), skippedCurves, droppedCVs );
+		}
+
+		for ( size_t i = 0; i < blocks.size(); ++i )
+		{
+			const CurveBlock& block = blocks[i];
+			int knotOfs = 0;
+			for ( int c = 0; c < block.numCurves(); ++c )
+			{
+				Spline3D* spline = shape.NewSpline();
+				for ( int k = 0; k < block.knotCounts[c]; ++k )
+				{
+					const CurveKnot& knot = block.knots[knotOfs + k];
+					spline->AddKnot(SplineKnot(
+						GetMaxKnotType(knot.type),
+						knot.type == knot_corner ? LTYPE_LINE : LTYPE_CURVE,
+						Point3(knot.point[0], knot.point[1], knot.point[2]),
+						Point3(knot.inVec[0], knot.inVec[1], knot.inVec[2]),
+						Point3(knot.outVec[0], knot.outVec[1], knot.outVec[2])));
+				}
+				spline->SetClosed( block.closed[c] ? 1 : 0 );
+				spline->ComputeBezPoints();
+				knotOfs += block.knotCounts[c];
+			}
+		}
+		shape.UpdateSels();
+		shape.InvalidateGeomCache();
+	}
+
+	void BuildObjectMesh( Mesh& mesh, HAPI_AssetId asset_id, HAPI_ObjectId object_id, float scl )
+	{
+		HAPI_AssetInfo asset_info;
+		HAPI_GetAssetInfo(hapi::Engine::instance()->session(), asset_id, &asset_info);
+		if ( !asset_info.objectCount )
+			return;
+
+		std::vector<HAPI_ObjectInfo> oinfo(asset_info.objectCount);
+		HAPI_GetObjects(hapi::Engine::instance()->session(), asset_id, &oinfo.front(), 0, asset_info.objectCount);
+		for ( size_t obj = 0; obj < oinfo.size(); ++obj )
+		{
+			if ( oinfo[obj].id != object_id )
+				continue;
+
+			// instanced objects are usually hidden, the instancer shows them
+			oinfo[obj].isVisible = true;
+
+			GeometryCache cache;
+			std::vector<CookPart> parts;
+			GatherCookParts( asset_id, &oinfo[obj], 1, true, cache, parts );
+
+			std::vector<PartSource> sources(parts.size());
+			std::vector<const PartSource*> convertSources(parts.size());
+			std::vector<PartBlock*> convertBlocks(parts.size());
+			for ( size_t i = 0; i < parts.size(); ++i )
+			{
+				PartTopology topo;
+				FetchTopology( asset_id, parts[i], topo );
+				FetchCookPart( asset_id, parts[i], topo, sources[i], cache.get(parts[i].key) );
+				convertSources[i] = &sources[i];
+				convertBlocks[i] = cache.find(parts[i].key);
+			}
+			ConvertParts( convertSources, convertBlocks, scl, false, GetSortByMaterial() );
+			std::vector<PartSource>().swap( sources );
+			AssembleMesh( mesh, parts, cache );
+			mesh.InvalidateTopologyCache();
+			break;
+		}
+	}
+
+	// up to count points of a part, read as short windows spread over the whole point range.
+	// the windows are cut so the total never exceeds count
+	static void SamplePoints( HAPI_AssetId asset_id, const CookPart& part, int count, std::vector<float>& points )
+	{
+		HAPI_AttributeInfo attr_info;
+		attr_info.exists = false;
+		HAPI_GetAttributeInfo(hapi::Engine::instance()->session(),
+			asset_id, part.key.object, part.key.geo, part.key.part,
+			"P",
+			HAPI_ATTROWNER_POINT,
+			&attr_info
+			);
+		if ( !attr_info.exists || attr_info.tupleSize != 3 || !attr_info.count )
+			return;
+
+		size_t ofs = points.size();
+		if ( count >= attr_info.count )
+		{
+			points.resize(ofs + attr_info.count * 3);
+			FetchFloatAttribute( asset_id, part, "P", attr_info, &points[ofs] );
+			return;
+		}
+
+		const int window = 64;
+		int numWindows = (count + window - 1) / window;
+		for ( int w = 0; w < numWindows; ++w )
+		{
+			int start = (int)((int64_t)attr_info.count * w / numWindows);
+			int next = (int)((int64_t)attr_info.count * (w + 1) / numWindows);
+			int length = std::min(std::min(window, count - w * window), next - start);
+
+			ofs = points.size();
+			points.resize(ofs + length * 3);
+			HAPI_GetAttributeFloatData(hapi::Engine::instance()->session(),
+				asset_id, part.key.object, part.key.geo, part.key.part,
+				"P",
+				&attr_info,
+				&points[ofs],
+				start, length
+				);
+		}
+	}
+
+	// points read per changed part for its proxy box. HAPI has no part bounds, the box is the
+	// bounds of this sample and can miss outliers between the windows
+#define PROXY_BOX_SAMPLES	(4096)
+
+	// viewport proxy: a box per part, or with maxPoints a point cloud of at most that many points.
+	// nothing is triangulated and no part is read in full, the cost depends on neither the face nor
+	// the point count. cache keeps the corners or the sample of every part, only parts that changed
+	// are read again
+	void BuildProxyFromCookResult( Mesh& mesh, GeometryCache& cache, HAPI_AssetId asset_id, float scl, bool forceUpdate, int maxPoints )
+	{
+		mesh.Init();
+
+		HAPI_AssetInfo asset_info;
+		HAPI_GetAssetInfo(hapi::Engine::instance()->session(), asset_id, &asset_info);
+		if ( !asset_info.objectCount )
+		{
+			cache.clear();
+			return;
+		}
+
+		std::vector<HAPI_ObjectInfo> oinfo(asset_info.objectCount);
+		HAPI_GetObjects(hapi::Engine::instance()->session(), asset_id, &oinfo.front(), 0, asset_info.objectCount);
+
+		std::vector<CookPart> parts;
+		GatherCookParts( asset_id, &oinfo.front(), asset_info.objectCount, forceUpdate, cache, parts );
+		std::vector<PartKey> keys(parts.size());
+		for ( size_t i = 0; i < parts.size(); ++i )
+			keys[i] = parts[i].key;
+		cache.retain( keys );
+		if ( parts.empty() )
+			return;
+
+		int64_t totalPoints = 0;
+		for ( size_t i = 0; i < parts.size(); ++i )
+			totalPoints += parts[i].info.pointCount;
+
+		// block.points holds the sample, or the two box corners, of a part. an unchanged part
+		// keeps its sample even if the budget shares moved
+		std::vector<PartBlock*> blocks(parts.size());
+		for ( size_t i = 0; i < parts.size(); ++i )
+		{
+			PartBlock& block = cache.get(parts[i].key);
+			blocks[i] = &block;
+			if ( !parts[i].dirty && block.points.size() )
+				continue;
+
+			block.clear();
+			block.fingerprint = GetPartFingerprint(parts[i].info);
+			if ( maxPoints > 0 )
+			{
+				// every part gets its share of the budget
+				int64_t pointCount = parts[i].info.pointCount;
+				int count = (int)std::min(pointCount, std::max((int64_t)1, (int64_t)maxPoints * pointCount / totalPoints));
+				SamplePoints( asset_id, parts[i], count, block.points );
+			}
+			else
+			{
+				std::vector<float> sample;
+				SamplePoints( asset_id, parts[i], PROXY_BOX_SAMPLES, sample );
+				if ( sample.size() )
+				{
+					float corners[6] = { FLT_MAX, FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX };
+					for ( size_t p = 0; p < sample.size(); ++p )
+					{
+						corners[p % 3] = std::min(corners[p % 3], sample[p]);
+						corners[3 + p % 3] = std::max(corners[3 + p % 3], sample[p]);
+					}
+					block.points.assign( corners, corners + 6 );
+				}
+			}
+			if ( block.points.size() )
+				ConvertPoints( &block.points.front(), block.numPoints(), scl );
+		}
+
+		if ( maxPoints > 0 )
+		{
+			int numPoints = 0;
+			for ( size_t i = 0; i < blocks.size(); ++i )
+				numPoints += blocks[i]->numPoints();
+
+			mesh.setNumVerts( numPoints );
+			mesh.setNumFaces( 0 );
+			int v = 0;
+			for ( size_t i = 0; i < blocks.size(); ++i )
+			{
+				const std::vector<float>& points = blocks[i]->points;
+				for ( size_t p = 0; p < points.size(); p += 3 )
+					mesh.verts[v++] = Point3(points[p+0], points[p+1], points[p+2]);
+			}
+			mesh.SetDispFlag( DISP_VERTTICKS );
+		}
+		else
+		{
+			// corner n has bit 0 = max x, bit 1 = max y, bit 2 = max z
+			static int boxQuads[6][4] = { {0,2,3,1}, {4,5,7,6}, {0,1,5,4}, {2,6,7,3}, {0,4,6,2}, {1,3,7,5} };
+
+			std::vector<Box3> boxes;
+			for ( size_t i = 0; i < blocks.size(); ++i )
+			{
+				const std::vector<float>& corners = blocks[i]->points;
+				if ( corners.size() != 6 )
+					continue;
+
+				Box3 box;
+				box += Point3(corners[0], corners[1], corners[2]);
+				box += Point3(corners[3], corners[4], corners[5]);
+				boxes.push_back( box );
+			}
+
+			int nverts = (int)boxes.size() * 8;
+			mesh.setNumVerts( nverts );
+			mesh.setNumFaces( (int)boxes.size() * 12 );
+			for ( size_t b = 0; b < boxes.size(); ++b )
+			{
+				int vOfs = (int)b * 8;
+				for ( int n = 0; n < 8; ++n )
+				{
+					mesh.verts[vOfs + n] = Point3(
+						(n & 1) ? boxes[b].pmax.x : boxes[b].pmin.x,
+						(n & 2) ? boxes[b].pmax.y : boxes[b].pmin.y,
+						(n & 4) ? boxes[b].pmax.z : boxes[b].pmin.z );
+				}
+				for ( int q = 0; q < 6; ++q )
+				{
+					MakeQuad( nverts, &mesh.faces[b * 12 + q * 2],
+						vOfs + boxQuads[q][0], vOfs + boxQuads[q][1], vOfs + boxQuads[q][2], vOfs + boxQuads[q][3], q, 0 );
+				}
+			}
+		}
+		mesh.InvalidateTopologyCache();
+	}
+
+	// houdini transform to max, the instanced mesh is already converted: rotation and scale
+	// are conjugated with the axis swap, the translation is converted like a point
+	static Matrix3 GetMaxTransform( const HAPI_Transform& transform, float scl )
+	{
+		float m[16];
+		HAPI_ConvertTransformQuatToMatrix(hapi::Engine::instance()->session(), &transform, m);
+
+		Matrix3 tm;
+		for ( int r = 0; r < 3; ++r )
+		{
+			// rows of C^-1 * M * C with C = (x, y, z) -> (x, -z, y)
+			const float* row = &m[(r == 0 ? 0 : r == 1 ? 2 : 1) * 4];
+			float sign = r == 1 ? -1.f : 1.f;
+			tm.SetRow(r, Point3(row[0], -row[2], row[1]) * sign);
+		}
+		tm.SetRow(3, Point3(m[12], -m[14], m[13]) * scl);
+		return tm;
+	}
+
+	void GetInstancers( HAPI_AssetId asset_id, float scl, std::vector<Instancer>& instancers )
+	{
+		HAPI_AssetInfo asset_info;
+		HAPI_GetAssetInfo(hapi::Engine::instance()->session(), asset_id, &asset_info);
+		if ( !asset_info.objectCount )
+			return;
+
+		std::vector<HAPI_ObjectInfo> oinfo(asset_info.objectCount);
+		std::vector<HAPI_Transform> objectTransforms(asset_info.objectCount);
+		HAPI_GetObjects(hapi::Engine::instance()->session(), asset_id, &oinfo.front(), 0, asset_info.objectCount);
+		HAPI_GetObjectTransforms(hapi::Engine::instance()->session(), asset_id, HAPI_SRT, &objectTransforms.front(), 0, asset_info.objectCount);
+		for ( size_t obj = 0; obj < oinfo.size(); ++obj )
+		{
+			if ( !oinfo[obj].isVisible || !oinfo[obj].isInstancer || oinfo[obj].objectToInstanceId < 0 )
+				continue;
+
+			// one instance per point of the instancer geometry
+			HAPI_PartInfo part_info;
+			if ( HAPI_GetPartInfo(hapi::Engine::instance()->session(), asset_id, oinfo[obj].id, 0, 0, &part_info) != HAPI_RESULT_SUCCESS || !part_info.pointCount )
+				continue;
+
+			std::vector<HAPI_Transform> transforms(part_info.pointCount);
+			if ( HAPI_GetInstanceTransforms(hapi::Engine::instance()->session(),
+					asset_id, oinfo[obj].id, 0,
+					HAPI_SRT,
+					&transforms.front(),
+					0, part_info.pointCount
+					) != HAPI_RESULT_SUCCESS )
+				continue;
+
+			Instancer instancer;
+			instancer.object = oinfo[obj].id;
+			instancer.source = oinfo[obj].objectToInstanceId;
+			instancer.name = hapi::Object(asset_id, oinfo[obj].id).objectInstancePath();
+			// the points are in the space of the instancer object, relative to the asset like GetOutputObjects
+			Matrix3 objectTM = GetMaxTransform( objectTransforms[obj], scl );
+			instancer.transforms.resize(transforms.size());
+			for ( size_t i = 0; i < transforms.size(); ++i )
+				instancer.transforms[i] = GetMaxTransform( transforms[i], scl ) * objectTM;
+			instancers.push_back(instancer);
+		}
+	}
+
+	void GetOutputObjects( HAPI_AssetId asset_id, float scl, std::vector<OutputObject>& objects )
+	{
+		HAPI_AssetInfo asset_info;
+		HAPI_GetAssetInfo(hapi::Engine::instance()->session(), asset_id, &asset_info);
+		if ( !asset_info.objectCount )
+			return;
+
+		std::vector<HAPI_ObjectInfo> oinfo(asset_info.objectCount);
+		std::vector<HAPI_Transform> transforms(asset_info.objectCount);
+		HAPI_GetObjects(hapi::Engine::instance()->session(), asset_id, &oinfo.front(), 0, asset_info.objectCount);
+		HAPI_GetObjectTransforms(hapi::Engine::instance()->session(), asset_id, HAPI_SRT, &transforms.front(), 0, asset_info.objectCount);
+		for ( size_t obj = 0; obj < oinfo.size(); ++obj )
+		{
+			if ( !oinfo[obj].isVisible || oinfo[obj].isInstancer || !oinfo[obj].geoCount )
+				continue;
+
+			OutputObject object;
+			object.id = oinfo[obj].id;
+			object.name = GetString(oinfo[obj].nameSH);
+			HAPI_NodeInfo node_info;
+			if ( HAPI_GetNodeInfo(hapi::Engine::instance()->session(), oinfo[obj].nodeId, &node_info) == HAPI_RESULT_SUCCESS )
+				object.path = GetString(node_info.internalNodePathSH);
+			if ( object.path.empty() )
+				object.path = object.name;
+			object.transform = GetMaxTransform( transforms[obj], scl );
+			object.geosChanged = oinfo[obj].haveGeosChanged ? true : false;
+			object.transformChanged = oinfo[obj].hasTransformChanged ? true : false;
+			objects.push_back(object);
 		}
 	}
 
@@ -1326,7 +2533,8 @@ namespace util
 		{
 			const size_t cleng = 1024;
 			WCHAR _result[cleng];
-			GetPrivateProfileString(_T("HoudiniEngine"), key, _T(""), &_result[0], cleng, path);
+			MSTR file = MSTR(path) + _T("\\HoudiniEngine.ini");
+			GetPrivateProfileString(_T("HoudiniEngine"), key, _T(""), &_result[0], cleng, file.data());
 
 			result = CStr::FromMCHAR(_result).data();
 		}
@@ -1342,7 +2550,8 @@ namespace util
 		const MCHAR* path = IPathConfigMgr::GetPathConfigMgr()->GetDir(APP_PLUGCFG_DIR);
 		if (path)
 		{
-			result = GetPrivateProfileInt(_T("HoudiniEngine"), key, -1, path);
+			MSTR file = MSTR(path) + _T("\\HoudiniEngine.ini");
+			result = GetPrivateProfileInt(_T("HoudiniEngine"), key, -1, file.data());
 		}
 
 		return result;
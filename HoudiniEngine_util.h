@@ -10,15 +10,55 @@
 
 #define GET_MAXSCRIPT_NODE(pNode) "mynode68K = maxOps.getNodeByHandle("<<pNode->GetHandle()<<")\n"
 
+class GeometryCache;
+struct ParticleCloud;
 
 namespace util
 {
+	// instancer object of an asset with one max transform per instance
+	struct Instancer
+	{
+		HAPI_ObjectId			object;
+		HAPI_ObjectId			source;		// instanced object
+		std::string				name;		// path of the instanced object
+		std::vector<Matrix3>	transforms;	// relative to the asset node, the instancer object transform included
+	};
+
+	// visible object of an asset that is not an instancer, with its max transform
+	struct OutputObject
+	{
+		HAPI_ObjectId			id;
+		std::string				name;
+		std::string				path;			// node path, unique in the asset
+		Matrix3					transform;
+		bool					geosChanged;
+		bool					transformChanged;
+	};
+
+	// primitive group over the faces of the assembled mesh, groups of the same name are merged
+	struct FaceGroup
+	{
+		std::string				name;
+		BitArray				faces;
+	};
+
 	std::string GetString(int string_handle);
 	int FindParm(std::vector<HAPI_ParmInfo>& parms, const char* name, int instanceNum = -1);
-	Point3 GetVertexNormal(Mesh* mesh, int faceNo, RVertex* rv);
+	void GetHoudiniTransform(const Matrix3& tm, float scl, float m[3][4]);
+	bool GetHoudiniMatrix(const Matrix3& tm, float scl, float m[16]);
 	void BuildBoxMesh(Mesh& mesh);
 	void BuildLogoMesh(Mesh& mesh);
-	void BuildMeshFromCookResult( Mesh& mesh, HAPI_AssetId asset_id, float scl, bool forceUpdate = false );
+	// returns true if the mesh was modified. object_id >= 0 only builds that object
+	bool BuildMeshFromCookResult( Mesh& mesh, GeometryCache& cache, HAPI_AssetId asset_id, float scl, bool forceUpdate = false, bool deformOnly = false, MNMesh* polyMesh = NULL, HAPI_ObjectId object_id = -1 );
+	// groups of the parts last assembled from cache over the faces of the tri mesh the node holds,
+	// in polygon mode a polygon covers its triangles. numFaces is the face count of that mesh
+	void GetFaceGroups( const GeometryCache& cache, int numFaces, std::vector<FaceGroup>& groups );
+	void BuildParticlesFromCookResult( ParticleCloud& cloud, HAPI_AssetId asset_id, float scl, bool forceUpdate = false );
+	void BuildShapeFromCookResult( BezierShape& shape, HAPI_AssetId asset_id, float scl );
+	void BuildObjectMesh( Mesh& mesh, HAPI_AssetId asset_id, HAPI_ObjectId object_id, float scl );
+	void BuildProxyFromCookResult( Mesh& mesh, GeometryCache& cache, HAPI_AssetId asset_id, float scl, bool forceUpdate = false, int maxPoints = 0 );
+	void GetInstancers( HAPI_AssetId asset_id, float scl, std::vector<Instancer>& instancers );
+	void GetOutputObjects( HAPI_AssetId asset_id, float scl, std::vector<OutputObject>& objects );
 	Mtl* CreateMaterial( HAPI_AssetId asset_id, TSTR& textureWorkPath );
 	std::string GanerateClassID(std::string& classname);
 	std::string GetProfileString(const MCHAR* key);
@@ -0,0 +1,85 @@
+#include "HoudiniEngine_xform.h"
+
+#ifdef HE_USE_SSE
+#include <emmintrin.h>
+#endif
+
+namespace util
+{
+	void HoudiniToMaxTransform( float scl, Affine34 m )
+	{
+		m[0][0] = scl; m[0][1] = 0.f; m[0][2] = 0.f;  m[0][3] = 0.f;
+		m[1][0] = 0.f; m[1][1] = 0.f; m[1][2] = -scl; m[1][3] = 0.f;
+		m[2][0] = 0.f; m[2][1] = scl; m[2][2] = 0.f;  m[2][3] = 0.f;
+	}
+
+	static inline void TransformPoint( const float* p, float* o, const Affine34 m )
+	{
+		float x = p[0];
+		float y = p[1];
+		float z = p[2];
+		o[0] = m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3];
+		o[1] = m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3];
+		o[2] = m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3];
+	}
+
+#ifdef HE_USE_SSE
+	// 4 points per iteration, xyz are transposed so every row is 3 mul + 3 add
+	static int TransformPointsSSE( const float* src, float* dst, int count, const Affine34 m )
+	{
+		__m128 m00 = _mm_set1_ps(m[0][0]), m01 = _mm_set1_ps(m[0][1]), m02 = _mm_set1_ps(m[0][2]), m03 = _mm_set1_ps(m[0][3]);
+		__m128 m10 = _mm_set1_ps(m[1][0]), m11 = _mm_set1_ps(m[1][1]), m12 = _mm_set1_ps(m[1][2]), m13 = _mm_set1_ps(m[1][3]);
+		__m128 m20 = _mm_set1_ps(m[2][0]), m21 = _mm_set1_ps(m[2][1]), m22 = _mm_set1_ps(m[2][2]), m23 = _mm_set1_ps(m[2][3]);
+
+		int blocks = count / 4;
+		for ( int i = 0; i < blocks; ++i )
+		{
+			const float* p = src + i * 12;
+			float* o = dst + i * 12;
+
+			// x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+			__m128 a = _mm_loadu_ps(p + 0);
+			__m128 b = _mm_loadu_ps(p + 4);
+			__m128 c = _mm_loadu_ps(p + 8);
+
+			__m128 t0 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2,1,3,2));	// x2 y2 x3 y3
+			__m128 t1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1,0,2,1));	// y0 z0 y1 z1
+			__m128 x = _mm_shuffle_ps(a, t0, _MM_SHUFFLE(2,0,3,0));
+			__m128 y = _mm_shuffle_ps(t1, t0, _MM_SHUFFLE(3,1,2,0));
+			__m128 z = _mm_shuffle_ps(t1, c, _MM_SHUFFLE(3,0,3,1));
+
+			__m128 X = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, x), _mm_mul_ps(m01, y)), _mm_add_ps(_mm_mul_ps(m02, z), m03));
+			__m128 Y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, x), _mm_mul_ps(m11, y)), _mm_add_ps(_mm_mul_ps(m12, z), m13));
+			__m128 Z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m20, x), _mm_mul_ps(m21, y)), _mm_add_ps(_mm_mul_ps(m22, z), m23));
+
+			__m128 xy = _mm_shuffle_ps(X, Y, _MM_SHUFFLE(2,0,2,0));	// X0 X2 Y0 Y2
+			__m128 yz = _mm_shuffle_ps(Y, Z, _MM_SHUFFLE(3,1,3,1));	// Y1 Y3 Z1 Z3
+			__m128 zx = _mm_shuffle_ps(Z, X, _MM_SHUFFLE(3,1,2,0));	// Z0 Z2 X1 X3
+
+			_mm_storeu_ps(o + 0, _mm_shuffle_ps(xy, zx, _MM_SHUFFLE(2,0,2,0)));
+			_mm_storeu_ps(o + 4, _mm_shuffle_ps(yz, xy, _MM_SHUFFLE(3,1,2,0)));
+			_mm_storeu_ps(o + 8, _mm_shuffle_ps(zx, yz, _MM_SHUFFLE(3,1,3,1)));
+		}
+		return blocks * 4;
+	}
+#endif
+
+	void TransformPoints( const float* src, float* dst, int count, const Affine34 m, int srcStride )
+	{
+		if ( srcStride && srcStride != (int)(3 * sizeof(float)) )
+		{
+			// strided source (MNVert etc.) stays scalar
+			const char* p = (const char*)src;
+			for ( int i = 0; i < count; ++i, p += srcStride )
+				TransformPoint( (const float*)p, dst + i * 3, m );
+			return;
+		}
+
+		int done = 0;
+#ifdef HE_USE_SSE
+		done = TransformPointsSSE( src, dst, count, m );
+#endif
+		for ( int i = done; i < count; ++i )
+			TransformPoint( src + i * 3, dst + i * 3, m );
+	}
+};
@@ -0,0 +1,22 @@
+#ifndef __HOUDINIENGINE_XFORM__
+#define __HOUDINIENGINE_XFORM__
+
+// define HE_NO_SIMD to force the scalar path
+#if !defined(HE_NO_SIMD) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__))
+#define HE_USE_SSE
+#endif
+
+namespace util
+{
+	// out = m * (x, y, z, 1), rows of a 3x4 affine matrix
+	typedef float Affine34[3][4];
+
+	// houdini y-up to max z-up with unit scale: (x, -z, y) * scl
+	void HoudiniToMaxTransform( float scl, Affine34 m );
+
+	// transform count packed float3 points. src and dst may be the same array.
+	// srcStride is the byte distance between source points, 0 = packed
+	void TransformPoints( const float* src, float* dst, int count, const Affine34 m, int srcStride = 0 );
+};
+
+#endif // __HOUDINIENGINE_XFORM__
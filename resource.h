@@ -26,6 +26,18 @@
 #define IDS_CLASS_NAME_HE_MOD           18
 #define IDS_HE_AUTOUPDATE               19
 #define IDS_HE_BYPASS                   20
+#define IDS_HE_DEFORM_ONLY              21
+#define IDS_HE_OUTPUT_POLY              22
+#define IDS_HE_CREATE_INSTANCES         23
+#define IDS_HE_CREATE_SPLINES           24
+#define IDS_HE_DISPLAY_MODE             25
+#define IDS_HE_CREATE_OBJECTS           26
+#define IDS_HE_SPLIT_OBJECTS            27
+#define IDS_CLASS_NAME_OBJECT           28
+#define IDS_HE_OBJECT_NAME              29
+#define IDS_HE_BASE_TRANSFORM           30
+#define IDS_HE_BAKE_INPUT_XFORM         31
+#define IDS_HE_SKIPPED_CURVES           32
 #define IDD_PANEL_GEOM                  102
 #define IDD_PANEL_MESH                  102
 #define IDD_PANEL_GEOM_INPUTS           105
@@ -59,6 +71,16 @@
 #define IDC_NODE_7                      1012
 #define IDC_NODE_8                      1013
 #define IDC_NODE_9                      1014
+#define IDC_DEFORM_ONLY                 1015
+#define IDC_OUTPUT_POLY                 1016
+#define IDC_CREATE_INSTANCES_BUTTON     1017
+#define IDC_CREATE_SPLINES_BUTTON       1018
+#define IDC_DISPLAY_FULL                1019
+#define IDC_DISPLAY_BOX                 1020
+#define IDC_DISPLAY_POINTS              1021
+#define IDC_SPLIT_OBJECTS               1022
+#define IDC_CREATE_OBJECTS_BUTTON       1023
+#define IDC_BAKE_INPUT_XFORM            1024
 #define IDC_COLOR                       1456
 
 // Next default values for new objects
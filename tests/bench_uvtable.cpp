@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include <map>
+#include <vector>
+#include "test.h"
+#include "HoudiniEngine_convert.h"
+
+// the std::map chain RestoreSharedUVs used before UVTable: uvNumber -> first uv index,
+// plus a list of alternate uv indices per uv. returns the uv count
+static int MapRestoreSharedUVs( const std::vector<int>& uvNumbers, const std::vector<float>& uvw, std::vector<int>& vertexList, std::vector<float>& tverts )
+{
+	size_t numVertices = uvNumbers.size();
+	vertexList.resize(numVertices);
+	tverts.resize(numVertices * 3);
+
+	// uvNumber -> uvIndex
+	std::map<int, int> uvNumberMap;
+	// uvIndex -> alternate uvIndex
+	std::vector<int> uvAlternateIndexMap(numVertices, -1);
+
+	int uvCount = 0;
+	for (size_t i = 0; i < numVertices; ++i)
+	{
+		int uvNumber = uvNumbers[i];
+		const float* p = &uvw[i * 3];
+
+		std::map<int, int>::iterator iter = uvNumberMap.find(uvNumber);
+
+		int lastMappedUVIndex = -1;
+		int mappedUVIndex = -1;
+		if (iter != uvNumberMap.end())
+		{
+			int currMappedUVIndex = iter->second;
+			while (currMappedUVIndex != -1)
+			{
+				// check that the UV coordinates are the same
+				const float* q = &tverts[currMappedUVIndex * 3];
+				if (p[0] == q[0] && p[1] == q[1] && p[2] == q[2])
+				{
+					mappedUVIndex = currMappedUVIndex;
+					break;
+				}
+
+				lastMappedUVIndex = currMappedUVIndex;
+				currMappedUVIndex = uvAlternateIndexMap[currMappedUVIndex];
+			}
+		}
+
+		if (mappedUVIndex == -1)
+		{
+			mappedUVIndex = uvCount;
+			uvCount++;
+
+			memcpy(&tverts[mappedUVIndex * 3], p, 3 * sizeof(float));
+
+			if (lastMappedUVIndex != -1)
+				uvAlternateIndexMap[lastMappedUVIndex] = mappedUVIndex;
+			else
+				uvNumberMap[uvNumber] = mappedUVIndex;
+		}
+
+		vertexList[i] = mappedUVIndex;
+	}
+	tverts.resize(uvCount * 3);
+	return uvCount;
+}
+
+static int TableRestoreSharedUVs( const std::vector<int>& uvNumbers, const std::vector<float>& uvw, std::vector<int>& vertexList, std::vector<float>& tverts )
+{
+	size_t numVertices = uvNumbers.size();
+	vertexList.resize(numVertices);
+	tverts.resize(numVertices * 3);
+
+	util::UVTable table(numVertices);
+	int uvCount = 0;
+	for (size_t i = 0; i < numVertices; ++i)
+	{
+		int mappedUVIndex = table.insert(uvNumbers[i], &uvw[i * 3], uvCount);
+		if (mappedUVIndex == uvCount)
+		{
+			memcpy(&tverts[uvCount * 3], &uvw[i * 3], 3 * sizeof(float));
+			uvCount++;
+		}
+		vertexList[i] = mappedUVIndex;
+	}
+	tverts.resize(uvCount * 3);
+	return uvCount;
+}
+
+// quads on a grid with vertex uvs, every interior point is shared by 4 vertices.
+// seams every 'seam' columns give the vertices on them another uvNumber and uv
+static void MakeGrid( int size, int seam, PartSource& src )
+{
+	src = PartSource();
+	PartUV uv;
+	uv.owner = owner_vertex;
+	uv.tupleSize = 3;
+
+	int row = size + 1;
+	for ( int y = 0; y < size; ++y )
+	{
+		for ( int x = 0; x < size; ++x )
+		{
+			const int corners[4][2] = { { x, y }, { x + 1, y }, { x + 1, y + 1 }, { x, y + 1 } };
+			src.polyCount.push_back(4);
+			for ( int c = 0; c < 4; ++c )
+			{
+				int px = corners[c][0], py = corners[c][1];
+				bool split = seam && px % seam == 0 && px != x;
+				src.polyConnect.push_back(py * row + px);
+				uv.uvNumbers.push_back(py * row + px + (split ? row * row : 0));
+				uv.uv.push_back((float)px / size + (split ? 1.f : 0.f));
+				uv.uv.push_back((float)py / size);
+				uv.uv.push_back(0.f);
+			}
+		}
+	}
+	src.uvs.push_back(uv);
+}
+
+static void TestMatchesMap()
+{
+	// random uvNumbers and uvs out of small sets, so most of them collide, with -0 and nan
+	srand(7);
+	std::vector<int> uvNumbers;
+	std::vector<float> uvw;
+	const float values[] = { 0.f, -0.f, 0.25f, 0.5f, 1.f, NAN };
+	for ( int i = 0; i < 20000; ++i )
+	{
+		uvNumbers.push_back(rand() % 50 - 10);
+		for ( int k = 0; k < 3; ++k )
+			uvw.push_back(values[rand() % (k == 2 ? 2 : 6)]);
+	}
+
+	std::vector<int> mapList, tableList;
+	std::vector<float> mapTVerts, tableTVerts;
+	int mapCount = MapRestoreSharedUVs(uvNumbers, uvw, mapList, mapTVerts);
+	int tableCount = TableRestoreSharedUVs(uvNumbers, uvw, tableList, tableTVerts);
+	CHECK_EQ(tableCount, mapCount);
+	CHECK(tableList == mapList);
+	CHECK_EQ(memcmp(tableTVerts.data(), mapTVerts.data(), tableTVerts.size() * sizeof(float)), 0);
+
+	// and through ConvertPart, vertex uvs keep the vertex order
+	PartSource src;
+	MakeGrid(40, 7, src);
+	PartBlock block;
+	util::ConvertPart(src, block, true);
+	MapRestoreSharedUVs(src.uvs[0].uvNumbers, src.uvs[0].uv, mapList, mapTVerts);
+	CHECK(block.maps[0].tverts == mapTVerts);
+	int corner = 0;
+	for ( int f = 0; f < block.numPolys(); ++f )
+	{
+		for ( int j = 0; j < 4; ++j )
+			CHECK_EQ(block.maps[0].polyTVerts[corner + j], mapList[corner + (j ? 4 - j : 0)]);
+		corner += 4;
+	}
+}
+
+static void Benchmark()
+{
+	// 512 * 512 quads, 1M vertices
+	PartSource src;
+	MakeGrid(512, 16, src);
+	const std::vector<int>& uvNumbers = src.uvs[0].uvNumbers;
+	const std::vector<float>& uvw = src.uvs[0].uv;
+
+	std::vector<int> mapList, tableList;
+	std::vector<float> mapTVerts, tableTVerts;
+	const int reps = 3;
+	double mapTime = TimeBest(reps, [&]() { MapRestoreSharedUVs(uvNumbers, uvw, mapList, mapTVerts); });
+	double tableTime = TimeBest(reps, [&]() { TableRestoreSharedUVs(uvNumbers, uvw, tableList, tableTVerts); });
+	CHECK(tableList == mapList);
+	CHECK(tableTVerts == mapTVerts);
+
+	printf("RestoreSharedUVs, %d vertices, %d tverts, best of %d\n", (int)uvNumbers.size(), (int)mapTVerts.size() / 3, reps);
+	printf("  %-20s %8.3f ms\n", "std::map chain", mapTime * 1e3);
+	printf("  %-20s %8.3f ms  %.2fx\n", "UVTable", tableTime * 1e3, mapTime / tableTime);
+}
+
+int main()
+{
+	TestMatchesMap();
+	Benchmark();
+	return TEST_RESULT();
+}
@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include "test.h"
+#include "HoudiniEngine_xform.h"
+
+// the scalar loop TransformPoints used before the sse path
+static void TransformPointsScalar( const float* src, float* dst, int count, const util::Affine34 m )
+{
+	for ( int i = 0; i < count; ++i )
+	{
+		const float* p = src + i * 3;
+		float* o = dst + i * 3;
+		float x = p[0];
+		float y = p[1];
+		float z = p[2];
+		o[0] = m[0][0] * x + m[0][1] * y + m[0][2] * z + m[0][3];
+		o[1] = m[1][0] * x + m[1][1] * y + m[1][2] * z + m[1][3];
+		o[2] = m[2][0] * x + m[2][1] * y + m[2][2] * z + m[2][3];
+	}
+}
+
+static void RandomPoints( std::vector<float>& points, int count )
+{
+	points.resize(count * 3);
+	for ( size_t i = 0; i < points.size(); ++i )
+		points[i] = (float)rand() / RAND_MAX * 200.f - 100.f;
+}
+
+// largest difference relative to the largest coordinate, the sse path adds the terms in another order
+static double MaxError( const std::vector<float>& a, const std::vector<float>& b )
+{
+	double err = 0.0, range = 1.0;
+	for ( size_t i = 0; i < a.size(); ++i )
+	{
+		err = std::max(err, fabs((double)a[i] - b[i]));
+		range = std::max(range, fabs((double)b[i]));
+	}
+	return err / range;
+}
+
+static void MakeMatrix( util::Affine34 m )
+{
+	const float values[3][4] = {
+		{ 0.8f, -0.36f, 0.48f, 10.f },
+		{ 0.6f, 0.48f, -0.64f, -5.f },
+		{ 0.f, 0.8f, 0.6f, 2.5f },
+	};
+	for ( int r = 0; r < 3; ++r )
+		for ( int c = 0; c < 4; ++c )
+			m[r][c] = values[r][c] * 2.54f;
+}
+
+static void TestMatchesScalar()
+{
+	util::Affine34 m;
+	MakeMatrix(m);
+
+	// every tail length after the 4 point blocks
+	for ( int count = 0; count < 19; ++count )
+	{
+		std::vector<float> src, dst, ref;
+		RandomPoints(src, count);
+		dst.assign(src.size() + 3, -1.f);
+		ref.resize(src.size());
+		util::TransformPoints(src.data(), dst.data(), count, m);
+		TransformPointsScalar(src.data(), ref.data(), count, m);
+		CHECK(MaxError(std::vector<float>(dst.begin(), dst.end() - 3), ref) < 1e-6);
+		// nothing written past the last point
+		CHECK(dst[count * 3] == -1.f && dst[count * 3 + 2] == -1.f);
+
+		// in place
+		util::TransformPoints(src.data(), src.data(), count, m);
+		CHECK(MaxError(src, ref) < 1e-6);
+	}
+
+	// strided source
+	std::vector<float> padded(4 * 7), packed(3 * 7), dst(3 * 7), ref(3 * 7);
+	RandomPoints(packed, 7);
+	for ( int i = 0; i < 7; ++i )
+		std::copy(&packed[i * 3], &packed[i * 3] + 3, &padded[i * 4]);
+	util::TransformPoints(padded.data(), dst.data(), 7, m, 4 * sizeof(float));
+	TransformPointsScalar(packed.data(), ref.data(), 7, m);
+	CHECK(MaxError(dst, ref) < 1e-6);
+}
+
+static void Benchmark()
+{
+	const int count = 1 << 20;
+	const int reps = 10;
+	util::Affine34 m;
+	MakeMatrix(m);
+
+	std::vector<float> src, dst(count * 3), ref(count * 3);
+	RandomPoints(src, count);
+
+	double scalar = TimeBest(reps, [&]() { TransformPointsScalar(src.data(), ref.data(), count, m); });
+	double simd = TimeBest(reps, [&]() { util::TransformPoints(src.data(), dst.data(), count, m); });
+	CHECK(MaxError(dst, ref) < 1e-6);
+
+#ifdef HE_USE_SSE
+	const char* path = "sse2";
+#else
+	const char* path = "scalar (HE_NO_SIMD)";
+#endif
+	printf("TransformPoints, %d points, best of %d\n", count, reps);
+	printf("  %-20s %8.3f ms  %6.2f ns/point\n", "scalar loop", scalar * 1e3, scalar * 1e9 / count);
+	printf("  %-20s %8.3f ms  %6.2f ns/point  %.2fx\n", path, simd * 1e3, simd * 1e9 / count, scalar / simd);
+}
+
+int main()
+{
+	TestMatchesScalar();
+	Benchmark();
+	return TEST_RESULT();
+}
@@ -0,0 +1,46 @@
+#ifndef __HOUDINIENGINE_TEST__
+#define __HOUDINIENGINE_TEST__
+
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+
+// minimal checks, a failing check is reported and makes main return 1
+static int testFailures = 0;
+
+#define CHECK(cond) \
+	do { if ( !(cond) ) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); testFailures++; } } while (0)
+
+#define CHECK_EQ(a, b) \
+	do { if ( !((a) == (b)) ) { printf("%s:%d: CHECK_EQ(%s, %s) failed\n", __FILE__, __LINE__, #a, #b); testFailures++; } } while (0)
+
+#define CHECK_NEAR(a, b, eps) \
+	do { if ( !(fabs((double)(a) - (double)(b)) <= (eps)) ) { printf("%s:%d: CHECK_NEAR(%s, %s) failed: %g vs %g\n", __FILE__, __LINE__, #a, #b, (double)(a), (double)(b)); testFailures++; } } while (0)
+
+#define TEST_RESULT() \
+	(testFailures ? (printf("%d check(s) failed\n", testFailures), 1) : (printf("ok\n"), 0))
+
+// seconds since the first call
+static double TestSeconds()
+{
+	static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// best of reps runs of func, in seconds
+template<class Func>
+static double TimeBest( int reps, const Func& func )
+{
+	double best = 1e30;
+	for ( int i = 0; i < reps; ++i )
+	{
+		double t0 = TestSeconds();
+		func();
+		double t = TestSeconds() - t0;
+		if ( t < best )
+			best = t;
+	}
+	return best;
+}
+
+#endif // __HOUDINIENGINE_TEST__
@@ -0,0 +1,390 @@
+#include <vector>
+#include "test.h"
+#include "HoudiniEngine_convert.h"
+
+// part with the given faces, no attributes
+static PartSource MakePart( const std::vector<int>& polyCount, const std::vector<int>& polyConnect )
+{
+	PartSource src;
+	src.polyCount = polyCount;
+	src.polyConnect = polyConnect;
+	return src;
+}
+
+static std::vector<int> Ints( int count, const int* values )
+{
+	return std::vector<int>(values, values + count);
+}
+
+static void TestTriangle()
+{
+	const int count[] = { 3 };
+	const int connect[] = { 0, 1, 2 };
+	PartSource src = MakePart(Ints(1, count), Ints(3, connect));
+
+	PartBlock block;
+	util::ConvertPart(src, block);
+
+	// winding is reversed, every edge visible
+	const int faces[] = { 0, 2, 1 };
+	CHECK(block.faces == Ints(3, faces));
+	CHECK_EQ(block.numFaces(), 1);
+	CHECK_EQ(block.edgeVis[0], 7);
+	CHECK_EQ(block.smGroups[0], 1u);
+	CHECK_EQ(block.matIds[0], 1);
+	CHECK(block.normals.empty());
+
+	// without uvs there is a dummy channel 1 with one tvert
+	CHECK_EQ(block.maps.size(), 1u);
+	CHECK_EQ(block.maps[0].channel, 1);
+	CHECK_EQ(block.maps[0].numTVerts(), 1);
+	const int tvFaces[] = { 0, 0, 0 };
+	CHECK(block.maps[0].tvFaces == Ints(3, tvFaces));
+}
+
+static void TestNGon()
+{
+	const int count[] = { 5 };
+	const int connect[] = { 0, 1, 2, 3, 4 };
+	PartSource src = MakePart(Ints(1, count), Ints(5, connect));
+
+	// fan from the first corner, inner edges hidden
+	PartBlock tris;
+	util::ConvertPart(src, tris);
+	const int faces[] = { 0, 2, 1, 0, 3, 2, 0, 4, 3 };
+	CHECK(tris.faces == Ints(9, faces));
+	CHECK_EQ(tris.edgeVis[0], 6);
+	CHECK_EQ(tris.edgeVis[1], 2);
+	CHECK_EQ(tris.edgeVis[2], 3);
+	CHECK(tris.polyDegrees.empty());
+
+	// polygon mode keeps the face, corners reversed after the first
+	PartBlock polys;
+	util::ConvertPart(src, polys, true);
+	const int degrees[] = { 5 };
+	const int verts[] = { 0, 4, 3, 2, 1 };
+	CHECK(polys.polyDegrees == Ints(1, degrees));
+	CHECK(polys.polyVerts == Ints(5, verts));
+	CHECK(polys.faces.empty());
+	CHECK(polys.edgeVis.empty());
+	CHECK_EQ(polys.smGroups.size(), 1u);
+	CHECK_EQ(polys.maps[0].polyTVerts.size(), 5u);
+}
+
+// two quads sharing the edge 1-2, vertex uvs with uvNumbers
+static PartSource MakeUVPart()
+{
+	const int count[] = { 4, 4 };
+	const int connect[] = { 0, 1, 2, 3, 1, 4, 5, 2 };
+	PartSource src = MakePart(Ints(2, count), Ints(8, connect));
+
+	const float uv[] = {
+		0.f, 0.f, 0.f,  0.5f, 0.f, 0.f,  0.5f, 1.f, 0.f,  0.f, 1.f, 0.f,
+		0.5f, 0.f, 0.f,  1.f, 0.f, 0.f,  1.f, 1.f, 0.f,  0.5f, 1.f, 0.f,
+	};
+	// point 1 is shared, point 2 has a seam (other uvNumber)
+	const int uvNumbers[] = { 0, 1, 2, 3, 1, 4, 5, 6 };
+
+	PartUV channel;
+	channel.channel = 1;
+	channel.owner = owner_vertex;
+	channel.tupleSize = 3;
+	channel.uv.assign(uv, uv + 24);
+	channel.uvNumbers = Ints(8, uvNumbers);
+	src.uvs.push_back(channel);
+	return src;
+}
+
+static void TestUVDedup()
+{
+	PartSource src = MakeUVPart();
+	PartBlock block;
+	util::ConvertPart(src, block);
+
+	CHECK_EQ(block.maps.size(), 1u);
+	const PartMap& map = block.maps[0];
+	CHECK_EQ(map.numTVerts(), 7);
+	CHECK_EQ(map.tvFaces.size(), 12u);
+
+	// tverts are handed out in first seen order, vertex 4 reuses tvert 1 and vertex 7 does not reuse tvert 2
+	const int tvFaces[] = { 0, 2, 1, 0, 3, 2, 1, 5, 4, 1, 6, 5 };
+	CHECK(map.tvFaces == Ints(12, tvFaces));
+	CHECK_NEAR(map.tverts[6 * 3 + 0], 0.5f, 0.f);
+	CHECK_NEAR(map.tverts[6 * 3 + 1], 1.f, 0.f);
+
+	// the uv of every corner survives
+	const int* connect = &src.polyConnect.front();
+	const int corners[] = { 0, 2, 1, 0, 3, 2, 4, 6, 5, 4, 7, 6 };
+	for ( int i = 0; i < 12; ++i )
+	{
+		for ( int k = 0; k < 3; ++k )
+			CHECK_EQ(map.tverts[map.tvFaces[i] * 3 + k], src.uvs[0].uv[corners[i] * 3 + k]);
+		CHECK_EQ(block.faces[i], connect[corners[i]]);
+	}
+
+	// polygon mode gives the same tverts
+	PartBlock polys;
+	util::ConvertPart(src, polys, true);
+	CHECK(polys.maps[0].tverts == map.tverts);
+	const int polyTVerts[] = { 0, 3, 2, 1, 1, 6, 5, 4 };
+	CHECK(polys.maps[0].polyTVerts == Ints(8, polyTVerts));
+}
+
+static void TestMaterialOrder()
+{
+	const int count[] = { 3, 3, 3, 4 };
+	const int connect[] = { 0, 1, 2, 2, 1, 3, 3, 1, 4, 4, 1, 5, 6 };
+	const int mid[] = { 3, 1, 3, 2 };
+	PartSource src = MakePart(Ints(4, count), Ints(13, connect));
+	src.mid = Ints(4, mid);
+
+	// houdini order without sorting
+	PartBlock unsorted;
+	util::ConvertPart(src, unsorted);
+	const unsigned short unsortedIds[] = { 3, 1, 3, 2, 2 };
+	CHECK(unsorted.matIds == std::vector<unsigned short>(unsortedIds, unsortedIds + 5));
+
+	// stable by material, the quad keeps both triangles together
+	PartBlock sorted;
+	util::ConvertPart(src, sorted, false, true);
+	const unsigned short sortedIds[] = { 1, 2, 2, 3, 3 };
+	const int faces[] = { 2, 3, 1,  4, 5, 1,  4, 6, 5,  0, 2, 1,  3, 4, 1 };
+	CHECK(sorted.matIds == std::vector<unsigned short>(sortedIds, sortedIds + 5));
+	CHECK(sorted.faces == Ints(15, faces));
+	CHECK_EQ(sorted.edgeVis[1], 6);
+	CHECK_EQ(sorted.edgeVis[2], 3);
+
+	// polygon mode sorts the same way
+	PartBlock polys;
+	util::ConvertPart(src, polys, true, true);
+	const unsigned short polyIds[] = { 1, 2, 3, 3 };
+	const int degrees[] = { 3, 4, 3, 3 };
+	CHECK(polys.matIds == std::vector<unsigned short>(polyIds, polyIds + 4));
+	CHECK(polys.polyDegrees == Ints(4, degrees));
+
+	// houdini materials are used when there is no max_mid
+	src.mid.clear();
+	src.allSameMaterial = false;
+	src.materialIds = Ints(4, mid);
+	PartBlock byMaterial;
+	util::ConvertPart(src, byMaterial, false, true);
+	CHECK(byMaterial.matIds == sorted.matIds);
+
+	// a single material is never reordered
+	src.allSameMaterial = true;
+	PartBlock same;
+	util::ConvertPart(src, same, false, true);
+	CHECK(same.faces == unsorted.faces);
+}
+
+static void TestGroups()
+{
+	// quad, triangle, pentagon
+	const int count[] = { 4, 3, 5 };
+	const int connect[] = { 0, 1, 2, 3, 3, 2, 4, 4, 2, 5, 6, 7 };
+	const int mid[] = { 2, 1, 2 };
+	const int inA[] = { 1, 0, 1 };
+	const int inB[] = { 0, 1, 0 };
+	PartSource src = MakePart(Ints(3, count), Ints(12, connect));
+	src.groups.resize(2);
+	src.groups[0].name = "a";
+	src.groups[0].membership = Ints(3, inA);
+	src.groups[1].name = "b";
+	src.groups[1].membership = Ints(3, inB);
+
+	// every triangle of a polygon is in its groups
+	PartBlock tris;
+	util::ConvertPart(src, tris);
+	CHECK_EQ(tris.numFaces(), 6);
+	CHECK_EQ(tris.groups.size(), 2u);
+	CHECK(tris.groups[0].name == "a");
+	const bool a[] = { true, true, false, true, true, true };
+	for ( int f = 0; f < 6; ++f )
+	{
+		CHECK_EQ(tris.groups[0].contains(f), a[f]);
+		CHECK_EQ(tris.groups[1].contains(f), !a[f]);
+	}
+
+	// one bit per polygon in polygon mode
+	PartBlock polys;
+	util::ConvertPart(src, polys, true);
+	CHECK(polys.groups[0].contains(0) && !polys.groups[0].contains(1) && polys.groups[0].contains(2));
+	CHECK(polys.groups[1].contains(1));
+
+	// the bits follow the faces when they are sorted
+	src.mid = Ints(3, mid);
+	PartBlock sorted;
+	util::ConvertPart(src, sorted, false, true);
+	CHECK(sorted.groups[1].contains(0));
+	for ( int f = 1; f < 6; ++f )
+		CHECK(sorted.groups[0].contains(f) && !sorted.groups[1].contains(f));
+}
+
+static void TestConvertParts()
+{
+	// the threaded path gives the same blocks, and converts the points
+	std::vector<PartSource> sources;
+	sources.push_back(MakeUVPart());
+	sources.push_back(MakeUVPart());
+	sources[1].mid.assign(2, 2);
+	sources[1].mid[1] = 1;
+
+	std::vector<PartBlock> blocks(sources.size());
+	std::vector<const PartSource*> srcPtrs;
+	std::vector<PartBlock*> blockPtrs;
+	for ( size_t i = 0; i < sources.size(); ++i )
+	{
+		blocks[i].points.assign(3, 0.f);
+		blocks[i].points[0] = 1.f;
+		blocks[i].points[1] = 2.f;
+		blocks[i].points[2] = 3.f;
+		srcPtrs.push_back(&sources[i]);
+		blockPtrs.push_back(&blocks[i]);
+	}
+	util::ConvertParts(srcPtrs, blockPtrs, 2.f, false, true, 4);
+
+	for ( size_t i = 0; i < sources.size(); ++i )
+	{
+		PartBlock single;
+		util::ConvertPart(sources[i], single, false, true);
+		CHECK(blocks[i].faces == single.faces);
+		CHECK(blocks[i].matIds == single.matIds);
+		CHECK(blocks[i].maps[0].tverts == single.maps[0].tverts);
+		CHECK(blocks[i].maps[0].tvFaces == single.maps[0].tvFaces);
+
+		// (x, -z, y) * scl
+		CHECK_NEAR(blocks[i].points[0], 2.f, 1e-6);
+		CHECK_NEAR(blocks[i].points[1], -6.f, 1e-6);
+		CHECK_NEAR(blocks[i].points[2], 4.f, 1e-6);
+	}
+}
+
+// curve cvs i = (i, 10 + i, 20 + i) in houdini space
+static CurveSource MakeCurves( CurveType type, bool periodic, int numCurves, const int* counts, int numCVs )
+{
+	CurveSource src;
+	src.type = type;
+	src.periodic = periodic;
+	src.order = type == curve_linear ? 2 : 4;
+	src.counts = Ints(numCurves, counts);
+	for ( int i = 0; i < numCVs; ++i )
+	{
+		src.cvs.push_back((float)i);
+		src.cvs.push_back(10.f + i);
+		src.cvs.push_back(20.f + i);
+	}
+	return src;
+}
+
+// (x, -z, y) of cv i
+static void CheckCV( const float* p, int i )
+{
+	CHECK_EQ(p[0], (float)i);
+	CHECK_EQ(p[1], -20.f - i);
+	CHECK_EQ(p[2], 10.f + i);
+}
+
+static void TestLinearCurves()
+{
+	const int counts[] = { 3, 2 };
+	CurveSource src = MakeCurves(curve_linear, false, 2, counts, 5);
+	CurveBlock block;
+	util::ConvertCurves(src, block, 1.f);
+
+	// every cv becomes a corner knot
+	CHECK_EQ(block.numCurves(), 2);
+	CHECK_EQ(block.knotCounts[0], 3);
+	CHECK_EQ(block.knotCounts[1], 2);
+	CHECK(!block.closed[0] && !block.closed[1]);
+	for ( int i = 0; i < 5; ++i )
+	{
+		CHECK_EQ(block.knots[i].type, knot_corner);
+		CheckCV(block.knots[i].point, i);
+		CheckCV(block.knots[i].inVec, i);
+		CheckCV(block.knots[i].outVec, i);
+	}
+	CHECK_EQ(block.skippedCurves, 0);
+
+	// closed curves keep their knots
+	src.periodic = true;
+	util::ConvertCurves(src, block, 1.f);
+	CHECK_EQ(block.knots.size(), 5u);
+	CHECK(block.closed[0] && block.closed[1]);
+}
+
+static void TestBezierCurves()
+{
+	// two cubic segments, the knots are cv 0, 3 and 6 with their neighbours as handles
+	const int seven[] = { 7 };
+	CurveSource src = MakeCurves(curve_bezier, false, 1, seven, 7);
+	CurveBlock open;
+	util::ConvertCurves(src, open, 1.f);
+	CHECK_EQ(open.numCurves(), 1);
+	CHECK_EQ(open.knotCounts[0], 3);
+	CHECK(!open.closed[0]);
+	CHECK_EQ(open.droppedCVs, 0);
+	CHECK_EQ(open.knots[1].type, knot_bezier);
+	CheckCV(open.knots[0].point, 0);
+	CheckCV(open.knots[0].inVec, 0);
+	CheckCV(open.knots[0].outVec, 1);
+	CheckCV(open.knots[1].point, 3);
+	CheckCV(open.knots[1].inVec, 2);
+	CheckCV(open.knots[1].outVec, 4);
+	CheckCV(open.knots[2].point, 6);
+	CheckCV(open.knots[2].outVec, 6);
+
+	// closed: six cvs are two segments, the first knot takes its in handle from the last cv
+	const int six[] = { 6 };
+	src = MakeCurves(curve_bezier, true, 1, six, 6);
+	CurveBlock closed;
+	util::ConvertCurves(src, closed, 1.f);
+	CHECK_EQ(closed.knotCounts[0], 2);
+	CHECK(closed.closed[0]);
+	CHECK_EQ(closed.droppedCVs, 0);
+	CheckCV(closed.knots[0].inVec, 5);
+	CheckCV(closed.knots[1].point, 3);
+
+	// an open curve of six cvs has one full segment, the last two cvs are counted as dropped
+	src = MakeCurves(curve_bezier, false, 1, six, 6);
+	CurveBlock partial;
+	util::ConvertCurves(src, partial, 1.f);
+	CHECK_EQ(partial.knotCounts[0], 2);
+	CHECK_EQ(partial.droppedCVs, 2);
+	CheckCV(partial.knots[1].point, 3);
+}
+
+static void TestDegenerateCurves()
+{
+	// one cv, no cvs, a valid curve, then a count that runs past the cvs
+	const int counts[] = { 1, 0, 2, 4 };
+	CurveSource src = MakeCurves(curve_linear, false, 4, counts, 5);
+	CurveBlock block;
+	util::ConvertCurves(src, block, 1.f);
+
+	CHECK_EQ(block.numCurves(), 1);
+	CHECK_EQ(block.knotCounts[0], 2);
+	CheckCV(block.knots[0].point, 1);
+	CheckCV(block.knots[1].point, 2);
+	CHECK_EQ(block.skippedCurves, 3);
+
+	// the counts are reset by the next call
+	const int two[] = { 2 };
+	src = MakeCurves(curve_linear, false, 1, two, 2);
+	util::ConvertCurves(src, block, 1.f);
+	CHECK_EQ(block.skippedCurves, 0);
+	CHECK_EQ(block.droppedCVs, 0);
+}
+
+int main()
+{
+	TestTriangle();
+	TestNGon();
+	TestUVDedup();
+	TestMaterialOrder();
+	TestGroups();
+	TestConvertParts();
+	TestLinearCurves();
+	TestBezierCurves();
+	TestDegenerateCurves();
+	return TEST_RESULT();
+}
@@ -0,0 +1,210 @@
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include "test.h"
+#include "HoudiniEngine_convert.h"
+
+// reference: max's VNormal chain as Mesh::buildNormals fills it, and the RVertex lookup of
+// GetVertexNormal from asciiexp/export.cpp, with doubles instead of Point3
+struct RefNormal
+{
+	unsigned int	sg;
+	double			n[3];
+};
+
+struct RefVertex
+{
+	std::vector<RefNormal>	normals;	// rn is normals[0], ern the whole list
+
+	// VNormal::AddNormal
+	void add( const double* n, unsigned int sg )
+	{
+		size_t k = 0;
+		while ( k < normals.size() && !(normals[k].sg & sg) )
+			++k;
+		if ( k == normals.size() )
+		{
+			RefNormal rn = { 0, { 0.0, 0.0, 0.0 } };
+			normals.push_back(rn);
+		}
+		normals[k].sg |= sg;
+		for ( int j = 0; j < 3; ++j )
+			normals[k].n[j] += n[j];
+	}
+
+	void normalize()
+	{
+		for ( size_t k = 0; k < normals.size(); ++k )
+		{
+			double* n = normals[k].n;
+			double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if ( len > 0.0 )
+				for ( int j = 0; j < 3; ++j )
+					n[j] /= len;
+		}
+	}
+};
+
+static void RefFaceNormal( const float* points, const int* face, bool clockwise, double* n )
+{
+	const float* p0 = points + face[0] * 3;
+	const float* p1 = points + face[1] * 3;
+	const float* p2 = points + face[2] * 3;
+	double e1[3] = { (double)p1[0] - p0[0], (double)p1[1] - p0[1], (double)p1[2] - p0[2] };
+	double e2[3] = { (double)p2[0] - p1[0], (double)p2[1] - p1[1], (double)p2[2] - p1[2] };
+	n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+	double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+	double s = len > 0.0 ? (clockwise ? -1.0 : 1.0) / len : 0.0;
+	for ( int j = 0; j < 3; ++j )
+		n[j] *= s;
+}
+
+static void RefSmoothNormals( const std::vector<float>& points, const std::vector<int>& faces,
+	const std::vector<unsigned int>& smGroups, bool clockwise, std::vector<double>& normals )
+{
+	int numFaces = (int)smGroups.size();
+	std::vector<double> faceNormals(numFaces * 3);
+	std::vector<RefVertex> verts(points.size() / 3);
+	for ( int f = 0; f < numFaces; ++f )
+	{
+		RefFaceNormal(&points.front(), &faces[f * 3], clockwise, &faceNormals[f * 3]);
+		if ( smGroups[f] )
+			for ( int j = 0; j < 3; ++j )
+				verts[faces[f * 3 + j]].add(&faceNormals[f * 3], smGroups[f]);
+	}
+	for ( size_t v = 0; v < verts.size(); ++v )
+		verts[v].normalize();
+
+	// GetVertexNormal: one entry is taken as it is, otherwise the last one sharing a group wins
+	normals.resize(faces.size() * 3);
+	for ( int c = 0; c < (int)faces.size(); ++c )
+	{
+		unsigned int sg = smGroups[c / 3];
+		const std::vector<RefNormal>& rv = verts[faces[c]].normals;
+		const double* n = &faceNormals[(c / 3) * 3];
+		if ( sg && rv.size() == 1 )
+			n = rv[0].n;
+		else if ( sg )
+		{
+			for ( size_t k = 0; k < rv.size(); ++k )
+				if ( rv[k].sg & sg )
+					n = rv[k].n;
+		}
+		for ( int j = 0; j < 3; ++j )
+			normals[c * 3 + j] = n[j];
+	}
+}
+
+static double MaxError( const std::vector<float>& a, const std::vector<double>& b )
+{
+	double err = 0.0;
+	for ( size_t i = 0; i < a.size(); ++i )
+		err = std::max(err, fabs(a[i] - b[i]));
+	return err;
+}
+
+static void CheckAgainstRef( const std::vector<float>& points, const std::vector<int>& faces,
+	const std::vector<unsigned int>& smGroups, bool clockwise, int numThreads )
+{
+	std::vector<double> ref;
+	RefSmoothNormals(points, faces, smGroups, clockwise, ref);
+
+	std::vector<float> normals(faces.size() * 3, -9.f);
+	util::BuildSmoothNormals(&points.front(), (int)points.size() / 3, &faces.front(), (int)smGroups.size(),
+		&smGroups.front(), 0, &normals.front(), clockwise, numThreads);
+	CHECK(MaxError(normals, ref) < 1e-5);
+}
+
+// three faces around point 0 in the order sg 1, sg 2, sg 1|2
+static void TestPartialOverlap()
+{
+	const float points[] = {
+		0.f, 0.f, 0.f,
+		1.f, 0.f, 0.f,
+		0.f, 1.f, 0.f,
+		-1.f, 0.f, 1.f,
+		0.f, -1.f, 1.f,
+	};
+	const int faces[] = { 0, 1, 2,  0, 2, 3,  0, 3, 4 };
+	const unsigned int sg[] = { 1, 2, 3 };
+	std::vector<float> p(points, points + 15);
+	std::vector<int> f(faces, faces + 9);
+	std::vector<unsigned int> s(sg, sg + 3);
+
+	std::vector<float> normals(27);
+	util::BuildSmoothNormals(&p.front(), 5, &f.front(), 3, &s.front(), 0, &normals.front());
+
+	// the third face joins the sg 1 entry, the entries are not merged, and it then reads the
+	// sg 2 entry because that is the last one it shares a group with
+	std::vector<double> fn(9);
+	for ( int i = 0; i < 3; ++i )
+		RefFaceNormal(&p.front(), &f[i * 3], false, &fn[i * 3]);
+	double a[3], len = 0.0;
+	for ( int j = 0; j < 3; ++j )
+	{
+		a[j] = fn[j] + fn[6 + j];
+		len += a[j] * a[j];
+	}
+	for ( int j = 0; j < 3; ++j )
+	{
+		CHECK_NEAR(normals[0 + j], a[j] / sqrt(len), 1e-6);	// face 0, corner 0
+		CHECK_NEAR(normals[9 + j], fn[3 + j], 1e-6);			// face 1, corner 0
+		CHECK_NEAR(normals[18 + j], fn[3 + j], 1e-6);			// face 2, corner 0
+	}
+	CheckAgainstRef(p, f, s, false, 1);
+}
+
+// a grid of quads with random heights and random smoothing groups out of a few bits
+static void TestRandomMesh()
+{
+	srand(23);
+	const int size = 96;
+	std::vector<float> points;
+	std::vector<int> faces;
+	std::vector<unsigned int> sg;
+	for ( int y = 0; y <= size; ++y )
+	{
+		for ( int x = 0; x <= size; ++x )
+		{
+			points.push_back((float)x);
+			points.push_back((float)y);
+			points.push_back((float)rand() / RAND_MAX);
+		}
+	}
+	for ( int y = 0; y < size; ++y )
+	{
+		for ( int x = 0; x < size; ++x )
+		{
+			int a = y * (size + 1) + x, b = a + 1, c = a + size + 2, d = a + size + 1;
+			const int quad[6] = { a, b, c, a, c, d };
+			faces.insert(faces.end(), quad, quad + 6);
+			sg.push_back((unsigned int)(rand() % 8));
+			sg.push_back((unsigned int)(rand() % 8));
+		}
+	}
+
+	CheckAgainstRef(points, faces, sg, false, 1);
+	CheckAgainstRef(points, faces, sg, true, 1);
+	CheckAgainstRef(points, faces, sg, false, 4);
+
+	// smoothing groups inside a larger face record
+	struct Face { int v[3]; unsigned int smGroup; unsigned int flags; };
+	std::vector<Face> records(sg.size());
+	for ( size_t f = 0; f < sg.size(); ++f )
+		records[f].smGroup = sg[f];
+	std::vector<float> strided(faces.size() * 3), packed(faces.size() * 3);
+	util::BuildSmoothNormals(&points.front(), (int)points.size() / 3, &faces.front(), (int)sg.size(),
+		&records[0].smGroup, sizeof(Face), &strided.front(), false, 2);
+	util::BuildSmoothNormals(&points.front(), (int)points.size() / 3, &faces.front(), (int)sg.size(),
+		&sg.front(), 0, &packed.front(), false, 2);
+	CHECK(strided == packed);
+}
+
+int main()
+{
+	TestPartialOverlap();
+	TestRandomMesh();
+	return TEST_RESULT();
+}